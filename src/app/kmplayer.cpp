@@ -904,10 +904,12 @@ void KMPlayerApp::readOptions() {
 #undef Bool
 
 void KMPlayerApp::minimalMode (bool by_user) {
-    /*unsigned long props = NET::WMWindowType;
-    NETWinInfo winfo (QX11Info::display (), winId (), QX11Info::appRootWindow(), props);
+    /*if (QX11Info::isPlatformX11 () && (m_minimal_mode || by_user)) {
+        NETWinInfo winfo (QX11Info::connection (), winId (),
+                QX11Info::appRootWindow (), NET::WMWindowType, NET::Properties2 ());
+        winfo.setWindowType (m_minimal_mode ? NET::Normal : NET::Utility);
+    }
     if (m_minimal_mode) {
-        winfo.setWindowType (NET::Normal);
         readOptions ();
         if (by_user)
             disconnect (m_view->controlPanel ()->button (KMPlayer::ControlPanel::button_playlist), SIGNAL (clicked ()), this, SLOT (slotMinimalMode ()));
@@ -919,8 +921,6 @@ void KMPlayerApp::minimalMode (bool by_user) {
         statusBar()->hide();
         if (by_user)
             connect (m_view->controlPanel ()->button (KMPlayer::ControlPanel::button_playlist), SIGNAL (clicked ()), this, SLOT (slotMinimalMode ()));
-        if (by_user)
-            winfo.setWindowType (NET::Utility);
     }
     m_view->viewArea ()->minimalMode ();
     if (by_user) {
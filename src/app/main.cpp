@@ -5,6 +5,7 @@
 */
 
 #include <unistd.h>
+#include <stdio.h>
 
 #include "config-kmplayer.h"
 #include <KAboutData>
@@ -14,8 +15,12 @@
 #include <QApplication>
 #include <QPointer>
 #include <QFileInfo>
+#include <QTimer>
 
 #include "kmplayer.h"
+#include "kmplayerpartbase.h"
+#include "kmplayerview.h"
+#include "viewarea.h"
 
 static QUrl makeUrl(const QString& link)
 {
@@ -25,6 +30,49 @@ static QUrl makeUrl(const QString& link)
     return QUrl::fromUserInput(link);
 }
 
+/*
+ * Once the document plays, step its clock by one 25fps frame at a time
+ * and paint each frame offscreen, printing the paint times. While the
+ * document loads, poll for that at a relaxed pace.
+ */
+static void renderFrames (KMPlayerApp *app, int count, const QString &dir)
+{
+    const int frame_ms = 40;
+    int frame = 0;
+    qint64 total = 0;
+    qint64 slowest = 0;
+    QTimer *timer = new QTimer (app);
+    QObject::connect (timer, &QTimer::timeout, app, [=] () mutable {
+        KMPlayer::Source *source = app->player ()->source ();
+        KMPlayer::Node *doc = source ? source->document ().ptr () : nullptr;
+        if (!doc || !doc->active ())
+            return; // still loading
+        KMPlayer::Document *d = doc->document ();
+        if (!frame) {
+            // align animation timers on the rendered frames
+            d->setDispatchMode (0, frame_ms);
+            d->setVirtualClock (true);
+            timer->setInterval (0); // the clock is virtual now
+        }
+        d->advanceClock (frame ? frame_ms : 0);
+        QString png;
+        if (!dir.isEmpty ())
+            png = QString ("%1/frame%2.png").arg (dir).arg (frame, 5, 10, QChar ('0'));
+        qint64 usec = app->view ()->viewArea ()->renderOffscreen (png);
+        fprintf (stdout, "frame %d %lld us\n", frame, (long long) usec);
+        total += usec;
+        if (usec > slowest)
+            slowest = usec;
+        if (++frame == count) {
+            fprintf (stdout, "%d frames avg %lld us max %lld us\n",
+                    count, (long long) (total / count), (long long) slowest);
+            timer->stop ();
+            qApp->quit ();
+        }
+    });
+    timer->start (50);
+}
+
 extern "C" Q_DECL_EXPORT int kdemain(int argc, char **argv)
 {
     setsid ();
@@ -48,6 +96,14 @@ extern "C" Q_DECL_EXPORT int kdemain(int argc, char **argv)
     QCommandLineParser parser;
     aboutData.setupCommandLine(&parser);
     parser.addPositionalArgument(QStringLiteral("File"), i18n("file to open"), i18n("+[File]"));
+    QCommandLineOption frames_option(QStringLiteral("frames"),
+            i18n("Render count frames of the document offscreen and print their paint times"),
+            QStringLiteral("count"));
+    QCommandLineOption frame_dir_option(QStringLiteral("frame-dir"),
+            i18n("Save the frames rendered with --frames as PNG in dir"),
+            QStringLiteral("dir"));
+    parser.addOption(frames_option);
+    parser.addOption(frame_dir_option);
     parser.process(app);
 
     aboutData.processCommandLine(&parser);
@@ -74,6 +130,9 @@ extern "C" Q_DECL_EXPORT int kdemain(int argc, char **argv)
             }
         }
         kmplayer->openDocumentFile (url);
+        int frames = parser.value(frames_option).toInt();
+        if (frames > 0)
+            renderFrames (kmplayer, frames, parser.value(frame_dir_option));
     }
     int retvalue = app.exec ();
 
@@ -6,6 +6,7 @@
 */
 
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "phononplayer.h"
@@ -14,8 +15,11 @@
 #include <QBoxLayout>
 #include <QDBusConnection>
 #include <QDBusMessage>
+#include <QDBusUnixFileDescriptor>
+#include <QImage>
 #include <QMap>
 #include <QTimer>
+#include <QTimerEvent>
 #include <QUrl>
 #include <QX11Info>
 
@@ -24,6 +28,7 @@
 #include <phonon/videoplayer.h>
 #include <phonon/videowidget.h>
 
+#include "sharedframes.h"
 #include "agentadaptor.h"
 #include "streamagentadaptor.h"
 
@@ -34,6 +39,8 @@ static QString control_path;
 static Agent *agent;
 typedef QMap <uint64_t, Stream *> AgentMap;
 static AgentMap agent_map;
+static const int frame_slots = 3;
+static const int frame_interval = 40; // ms
 
 Agent::Agent ()
     : stay_alive_timer (0)
@@ -65,6 +72,15 @@ void Agent::newStream (const QString &url, uint64_t wid)
     agent_map.insert (wid, new Stream (nullptr, url, wid));
 }
 
+void Agent::newPausedStream (const QString &url, uint64_t wid)
+{
+    if (stay_alive_timer) {
+        killTimer (stay_alive_timer);
+        stay_alive_timer = 0;
+    }
+    agent_map.insert (wid, new Stream (nullptr, url, wid, true));
+}
+
 void Agent::quit ()
 {
     qDebug ("quit");
@@ -83,8 +99,11 @@ void Agent::timerEvent (QTimerEvent *)
     quit ();
 }
 
-Stream::Stream (QWidget *parent, const QString &url, unsigned long wid)
-    : QX11EmbedWidget (parent), m_url (url), video_handle (wid)
+Stream::Stream (QWidget *parent, const QString &url, unsigned long wid,
+        bool paused)
+    : QX11EmbedWidget (parent), m_url (url), video_handle (wid),
+      m_frames (nullptr), m_frames_size (0), frame_timer (0),
+      m_prerolling (paused)
     //: QWidget (parent), video_handle (wid)
 {
     setAttribute(Qt::WA_NativeWindow);
@@ -132,10 +151,14 @@ void Stream::init () {
         m_media->setCurrentSource (QUrl::fromLocalFile(m_url));
     else
         m_media->setCurrentSource (QUrl (m_url));
-    play ();
+    if (m_prerolling)
+        m_media->pause (); // loads and buffers the stream
+    else
+        play ();
 }
 
 Stream::~Stream () {
+    unmapFrames ();
     delete m_media;
     agent->streamDestroyed (video_handle);
 }
@@ -156,7 +179,10 @@ void Stream::play () {
 }
 
 void Stream::pause () {
-    if (m_media->state () == Phonon::PausedState)
+    if (m_prerolling) { // maybe still loading
+        m_prerolling = false;
+        play ();
+    } else if (m_media->state () == Phonon::PausedState)
         m_media->play ();
     else
         m_media->pause ();
@@ -176,6 +202,89 @@ void Stream::volume (int value) {
     m_aoutput->setVolume (1.0 * value / 100);
 }
 
+void Stream::exportFrames (bool enable) {
+    qDebug ("exportFrames %d@%lu", enable, video_handle);
+    if (enable && !frame_timer) {
+        frame_timer = startTimer (frame_interval);
+    } else if (!enable && frame_timer) {
+        killTimer (frame_timer);
+        frame_timer = 0;
+        unmapFrames ();
+    }
+}
+
+void Stream::timerEvent (QTimerEvent *e) {
+    if (e->timerId () == frame_timer)
+        exportFrame ();
+}
+
+void Stream::unmapFrames () {
+    if (m_frames) {
+        munmap (m_frames, m_frames_size);
+        m_frames = nullptr;
+        m_frames_size = 0;
+    }
+}
+
+bool Stream::mapFrames (int width, int height) {
+    unmapFrames ();
+    uint32_t stride = width * 4;
+    size_t len = KMPlayer::SharedFrames::size (stride, height, frame_slots);
+    int fd = memfd_create ("kmplayer-frames", MFD_CLOEXEC);
+    if (fd < 0) {
+        qDebug ("memfd_create failed");
+        return false;
+    }
+    void *p = MAP_FAILED;
+    if (!ftruncate (fd, len))
+        p = mmap (nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == p) {
+        qDebug ("frame buffer allocation failed");
+        close (fd);
+        return false;
+    }
+    m_frames = (KMPlayer::SharedFrames *) p;
+    m_frames_size = len;
+    m_frames->init (width, height, stride, frame_slots);
+
+    QDBusMessage msg = QDBusMessage::createMethodCall (
+            control_service, m_master_stream_path,
+            "org.kde.kmplayer.StreamMaster", "frameBuffer");
+    msg << QVariant::fromValue (QDBusUnixFileDescriptor (fd))
+        << (uint) width << (uint) height << stride << (uint) frame_slots;
+    QDBusConnection::sessionBus().send (msg);
+    close (fd); // QDBusUnixFileDescriptor holds a dup
+    return true;
+}
+
+void Stream::exportFrame () {
+    if (m_media->state () != Phonon::PlayingState || !m_media->hasVideo ())
+        return;
+    // Phonon has no frame callback, so take what the video widget shows
+    QImage img = m_vwidget->snapshot ();
+    if (img.isNull ())
+        return;
+    if (img.format () != QImage::Format_ARGB32_Premultiplied)
+        img = img.convertToFormat (QImage::Format_ARGB32_Premultiplied);
+    if ((!m_frames ||
+                m_frames->width != (uint32_t) img.width () ||
+                m_frames->height != (uint32_t) img.height ()) &&
+            !mapFrames (img.width (), img.height ()))
+        return;
+    uint32_t slot = m_frames->writeSlot ();
+    unsigned char *dst = m_frames->data (slot);
+    const int bytes = img.width () * 4;
+    for (int y = 0; y < img.height (); ++y)
+        memcpy (dst + y * m_frames->stride, img.constScanLine (y), bytes);
+    m_frames->publish (slot);
+
+    QDBusMessage msg = QDBusMessage::createMethodCall (
+            control_service, m_master_stream_path,
+            "org.kde.kmplayer.StreamMaster", "frameReady");
+    msg << slot;
+    QDBusConnection::sessionBus().send (msg);
+}
+
 void Stream::hasVideoChanged (bool hasVideo) {
     qDebug ("hasVideoChanged %d", hasVideo);
     m_vwidget->setVisible (hasVideo);
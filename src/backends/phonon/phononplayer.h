@@ -17,6 +17,11 @@ typedef QWidget QX11EmbedWidget;
 #include <phonon/phononnamespace.h>
 
 
+namespace KMPlayer
+{
+    struct SharedFrames;
+} // namespace KMPlayer
+
 namespace Phonon
 {
     class VideoWidget;
@@ -31,6 +36,8 @@ public:
     Agent();
 
     void newStream (const QString &url, uint64_t wid);
+    /* like newStream, but buffers and waits for a pause call to play */
+    void newPausedStream (const QString &url, uint64_t wid);
     void quit ();
 
     void streamDestroyed (uint64_t wid);
@@ -45,7 +52,8 @@ private:
 class Stream : public QX11EmbedWidget { // QWidget {
     Q_OBJECT
 public:
-    Stream (QWidget *parent, const QString &url, unsigned long wid);
+    Stream (QWidget *parent, const QString &url, unsigned long wid,
+            bool paused=false);
     ~Stream () override;
 
     void play ();
@@ -53,8 +61,10 @@ public:
     void stop ();
     void seek (uint64_t position, bool absolute);
     void volume (int value);
+    void exportFrames (bool enable);
 
-//protected:
+protected:
+    void timerEvent (QTimerEvent *e) override;
 //    bool x11Event (XEvent *event);
 
 private Q_SLOTS:
@@ -68,12 +78,20 @@ private Q_SLOTS:
     void finished ();
 
 private:
+    void exportFrame ();
+    bool mapFrames (int width, int height);
+    void unmapFrames ();
+
     Phonon::VideoWidget *m_vwidget;
     Phonon::AudioOutput *m_aoutput;
     Phonon::MediaObject *m_media;
     QString m_url;
     QString m_master_stream_path;
     unsigned long video_handle;
+    KMPlayer::SharedFrames *m_frames;
+    size_t m_frames_size;
+    int frame_timer;
+    bool m_prerolling;
 };
 
 #endif
@@ -14,6 +14,7 @@
 #include "expression.h"
 
 #include <QRegExp>
+#include <QHash>
 
 using namespace KMPlayer;
 
@@ -99,20 +100,41 @@ NodeValue* Expression::iterator::operator->() {
 namespace {
 
 struct EvalState {
+    // how an evaluation used a node, see AST::dependsOn
+    enum { DepSelf = 1, DepChildren = 2, DepSubtree = 4 };
+
     EvalState (EvalState *p, const QString &root_tag=QString())
      : def_root_tag (root_tag), root (nullptr),
-       iterator(nullptr), parent (p),
-       sequence (1), ref_count (0) {}
+       iterator(nullptr), parent (p), deps (nullptr),
+       sequence (1), ref_count (0), deps_valid (false) {}
+    ~EvalState () { delete deps; }
 
     void addRef () { ++ref_count; }
     void removeRef () { if (--ref_count == 0) delete this; }
+    EvalState *top () {
+        EvalState *es = this;
+        while (es->parent)
+            es = es->parent;
+        return es;
+    }
+    void depend (Node *n, int how) {
+        EvalState *es = top ();
+        if (es->deps && n)
+            (*es->deps)[n] |= how;
+    }
+    QString value (const NodeValue &v) {
+        depend (v.node, v.attr ? DepSelf : DepSubtree);
+        return v.value ();
+    }
 
     QString def_root_tag;
     NodeValue root;
     ExprIterator* iterator;
     EvalState *parent;
+    QHash <Node *, int> *deps; // only in the top state, when tracked
     int sequence;
     int ref_count;
+    bool deps_valid;
 };
 
 struct AST : public Expression {
@@ -133,6 +155,8 @@ struct AST : public Expression {
     virtual Type type(bool calc) const;
     void setRoot (Node *root) override;
     void setRoot (const NodeValue &value);
+    void trackDependencies () override;
+    bool dependsOn (Node *n) const override;
 #ifdef KMPLAYER_EXPR_DEBUG
     virtual void dump () const;
 #endif
@@ -572,7 +596,28 @@ ExprIterator* AST::exprIterator(ExprIterator* parent) const {
 }
 
 Expression::iterator AST::begin() const {
-    return iterator(exprIterator(nullptr));
+    // yields the results, recording them as dependencies when tracked
+    struct ResultIterator : public ExprIterator {
+        EvalState *eval_state;
+        ResultIterator(ExprIterator* p, EvalState* es)
+         : ExprIterator(p), eval_state(es) {
+            pullNext();
+        }
+        void pullNext() {
+            cur_value = parent->cur_value;
+            eval_state->depend(cur_value.node, EvalState::DepSelf);
+        }
+        void next() override {
+            assert(!atEnd());
+            parent->next();
+            pullNext();
+            ++position;
+        }
+    };
+    ExprIterator* it = exprIterator(nullptr);
+    if (eval_state->top()->deps)
+        it = new ResultIterator(it, eval_state);
+    return iterator(it);
 }
 
 Expression::iterator AST::end() const {
@@ -590,6 +635,37 @@ void AST::setRoot (Node *root) {
 void AST::setRoot (const NodeValue& value) {
     eval_state->root = value;
     eval_state->sequence++;
+    if (eval_state->deps && !eval_state->parent) { // a new evaluation
+        eval_state->deps->clear ();
+        eval_state->deps_valid = true;
+    }
+}
+
+void AST::trackDependencies () {
+    EvalState *es = eval_state->top ();
+    if (!es->deps)
+        es->deps = new QHash <Node *, int>;
+}
+
+/*
+ * The nodes yielded can only change when n itself was yielded or read, when
+ * the children of n's parent were listed, eg. n was inserted or removed, or
+ * when the whole subtree of one of n's ancestors was walked or read.
+ */
+bool AST::dependsOn (Node *n) const {
+    const EvalState *es = eval_state->top ();
+    if (!es->deps || !es->deps_valid)
+        return true; // not known
+    const QHash <Node *, int> &deps = *es->deps;
+    if (deps.value (n))
+        return true;
+    Node *p = n->parentNode ();
+    if (p && (deps.value (p) & EvalState::DepChildren))
+        return true;
+    for (; p; p = p->parentNode ())
+        if (deps.value (p) & EvalState::DepSubtree)
+            return true;
+    return false;
 }
 
 #ifdef KMPLAYER_EXPR_DEBUG
@@ -717,7 +793,7 @@ QString SequenceBase::toString () const {
         string.clear();
         ExprIterator* it = exprIterator(nullptr);
         if (!it->atEnd()) {
-            string = it->cur_value.value();
+            string = eval_state->value(it->cur_value);
             while (!it->atEnd()) {
                 it->next();
             }
@@ -751,15 +827,21 @@ AST::Type SequenceBase::type(bool calc) const {
 ExprIterator* Step::exprIterator(ExprIterator* parent) const {
 
     struct ChildrenIterator : public ExprIterator {
-        ChildrenIterator(ExprIterator* p) : ExprIterator(p) {
+        EvalState* eval_state;
+        const int dependency;
+        ChildrenIterator(ExprIterator* p, EvalState* es,
+                int dep=EvalState::DepChildren)
+         : ExprIterator(p), eval_state(es), dependency(dep) {
             pullNext();
         }
         void pullNext() {
-            for (; !parent->atEnd(); parent->next())
+            for (; !parent->atEnd(); parent->next()) {
+                eval_state->depend(parent->cur_value.node, dependency);
                 if (parent->cur_value.node && parent->cur_value.node->firstChild()) {
                     cur_value = NodeValue(parent->cur_value.node->firstChild());
                     return;
                 }
+            }
             cur_value = NodeValue(nullptr, nullptr);
         }
         void next() override {
@@ -773,9 +855,13 @@ ExprIterator* Step::exprIterator(ExprIterator* parent) const {
         }
     };
     struct SiblingIterator : public ExprIterator {
+        EvalState* eval_state;
         const bool forward;
-        SiblingIterator(ExprIterator* p, bool fw) : ExprIterator(p), forward(fw) {
+        SiblingIterator(ExprIterator* p, EvalState* es, bool fw)
+         : ExprIterator(p), eval_state(es), forward(fw) {
             cur_value = p->cur_value;
+            if (cur_value.node)
+                eval_state->depend(cur_value.node->parentNode(), EvalState::DepChildren);
             pullNext();
         }
         void pullNext() {
@@ -789,6 +875,8 @@ ExprIterator* Step::exprIterator(ExprIterator* parent) const {
                 }
                 parent->next();
                 cur_value = parent->cur_value;
+                if (cur_value.node)
+                    eval_state->depend(cur_value.node->parentNode(), EvalState::DepChildren);
             }
             cur_value = NodeValue(nullptr, nullptr);
         }
@@ -799,7 +887,8 @@ ExprIterator* Step::exprIterator(ExprIterator* parent) const {
         }
     };
     struct DescendantIterator : public ChildrenIterator {
-        DescendantIterator(ExprIterator* p) : ChildrenIterator(p)
+        DescendantIterator(ExprIterator* p, EvalState* es)
+         : ChildrenIterator(p, es, EvalState::DepSubtree)
         {}
         void next() override {
             assert(cur_value.node);
@@ -821,6 +910,58 @@ ExprIterator* Step::exprIterator(ExprIterator* parent) const {
             ++position;
         }
     };
+    // Named descendants from the Document's name index when the context
+    // is the Document itself, else by walking the context's descendants
+    struct IndexedDescendantIterator : public ExprIterator {
+        EvalState* eval_state;
+        TrieString name;
+        QVector<Node*> nodes;
+        int index;
+        IndexedDescendantIterator(ExprIterator* p, EvalState* es, const QString& n)
+         : ExprIterator(p), eval_state(es), name(n), index(0) {
+            collect();
+            pullNext();
+        }
+        void collect() {
+            nodes.clear();
+            index = 0;
+            Node* ctx = parent->atEnd() ? nullptr : parent->cur_value.node;
+            if (!ctx)
+                return;
+            eval_state->depend(ctx, EvalState::DepSubtree);
+            if (ctx == ctx->document()) {
+                nodes = ctx->document()->nodesByName(name);
+            } else {
+                for (Node* n = ctx->firstChild(); n; ) {
+                    if (name == n->nodeName())
+                        nodes.append(n);
+                    if (n->firstChild()) {
+                        n = n->firstChild();
+                        continue;
+                    }
+                    while (n != ctx && !n->nextSibling())
+                        n = n->parentNode();
+                    n = n == ctx ? nullptr : n->nextSibling();
+                }
+            }
+        }
+        void pullNext() {
+            while (!parent->atEnd()) {
+                if (index < nodes.size()) {
+                    cur_value = NodeValue(nodes[index++]);
+                    return;
+                }
+                parent->next();
+                collect();
+            }
+            cur_value = NodeValue(nullptr, nullptr);
+        }
+        void next() override {
+            assert(!atEnd());
+            pullNext();
+            ++position;
+        }
+    };
     struct StepIterator : public ExprIterator {
         const Step* step;
 
@@ -875,12 +1016,14 @@ ExprIterator* Step::exprIterator(ExprIterator* parent) const {
     if (context_node)
         return parent;
     ExprIterator* it = parent;
-    if (axes & DescendantAxis)
-        it = new DescendantIterator(parent);
+    if (DescendantAxis == axes && !string.isEmpty())
+        it = new IndexedDescendantIterator(parent, eval_state, string);
+    else if (axes & DescendantAxis)
+        it = new DescendantIterator(parent, eval_state);
     else if (axes & FollowingSiblingAxis || axes & PrecedingSiblingAxis)
-        it = new SiblingIterator(parent, axes & FollowingSiblingAxis);
+        it = new SiblingIterator(parent, eval_state, axes & FollowingSiblingAxis);
     else if (!(axes & AttributeAxis))
-        it = new ChildrenIterator(parent);
+        it = new ChildrenIterator(parent, eval_state);
     return new StepIterator(it, this);
 }
 
@@ -1017,7 +1160,7 @@ bool StartsWith::toBool () const {
             if (s)
                 b = first_child->toString ().startsWith (s->toString ());
             else if (eval_state->parent)
-                b = eval_state->root.value ().startsWith (first_child->toString ());
+                b = eval_state->value (eval_state->root).startsWith (first_child->toString ());
         }
     }
     return b;
@@ -1134,7 +1277,7 @@ int StringLength::toInt () const {
         if (first_child)
             i = first_child->toString ().length ();
         else if (eval_state->parent)
-            i = eval_state->root.value ().length ();
+            i = eval_state->value (eval_state->root).length ();
         else
             i = 0;
     }
@@ -1172,10 +1315,10 @@ QString StringJoin::toString () const {
                 QString sep;
                 if (child->next_sibling)
                     sep = child->next_sibling->toString();
-                string = it->cur_value.value ();
+                string = eval_state->value (it->cur_value);
                 it->next();
                 for (; !it->atEnd(); it->next())
-                    string += sep + it->cur_value.value();
+                    string += sep + eval_state->value (it->cur_value);
             }
             delete it;
         }
@@ -2210,6 +2353,38 @@ Expression* KMPlayer::evaluateExpr(const QByteArray& expr, const QString &root)
     }
     return nullptr;
 }
+namespace {
+
+struct ExprCache {
+    ~ExprCache () {
+        clear ();
+    }
+    void clear () {
+        QHash <QString, Expression *>::const_iterator i = map.constBegin ();
+        for (; i != map.constEnd (); ++i)
+            delete i.value ();
+        map.clear ();
+    }
+    QHash <QString, Expression *> map;
+};
+
+}
+
+static const int expr_cache_max = 1024;
+
+Expression* KMPlayer::compiledExpr(const QString& expr, const QString& root) {
+    static ExprCache cache;
+    const QString key = root + QChar ('\n') + expr;
+    QHash <QString, Expression *>::const_iterator i = cache.map.constFind (key);
+    if (i != cache.map.constEnd ())
+        return i.value ();
+    if (cache.map.size () >= expr_cache_max)
+        cache.clear (); // generated expressions, start all over
+    Expression *e = evaluateExpr (expr.toUtf8 (), root);
+    cache.map.insert (key, e); // also remember failures
+    return e;
+}
+
 /*
 int main (int argc, char **argv) {
     AST ast;
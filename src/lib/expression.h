@@ -52,9 +52,27 @@ public:
     virtual iterator begin() const = 0;
     virtual iterator end() const = 0;
     virtual void setRoot (Node *root) = 0;
+    /**
+     * Record the nodes read while evaluating, from the next setRoot () on
+     */
+    virtual void trackDependencies () = 0;
+    /**
+     * Returns false if a change of n's value or children can't change what
+     * the evaluation since the last setRoot () yielded, so it doesn't need
+     * evaluating again. True when dependencies aren't tracked.
+     */
+    virtual bool dependsOn (Node *n) const = 0;
 };
 
-Expression* evaluateExpr(const QByteArray& expr, const QString& root = QString());
+KMPLAYERCOMMON_EXPORT Expression* evaluateExpr(const QByteArray& expr, const QString& root = QString());
+
+/**
+ * Parsed expression for expr, shared by all callers of the same source text
+ * and root tag. It's owned by a cache, so callers bind it with setRoot ()
+ * before evaluating and don't keep it around or delete it.
+ * Returns null if expr doesn't parse.
+ */
+KMPLAYERCOMMON_EXPORT Expression* compiledExpr(const QString& expr, const QString& root = QString());
 
 }
 
@@ -223,6 +223,10 @@ void RP::Image::message (MessageType msg, void *content) {
     if (msg == MsgMediaReady) {
         if (media_info)
             dataArrived ();
+    } else if (msg == MsgMediaUpdated) {
+        Node *p = parentNode ();
+        if (p && p->id == RP::id_node_imfl && p->active ())
+            static_cast <RP::Imfl *> (p)->repaint ();
     } else {
         Mrl::message (msg, content);
     }
@@ -231,7 +235,7 @@ void RP::Image::message (MessageType msg, void *content) {
 void RP::Image::dataArrived () {
     qCDebug(LOG_KMPLAYER_COMMON) << "RP::Image::remoteReady";
     ImageMedia *im = media_info->media ? (ImageMedia *)media_info->media : nullptr;
-    if (im && !im->isEmpty ()) {
+    if (im && (!im->isEmpty () || im->decoding ())) {
         size.width = im->cached_img->width;
         size.height = im->cached_img->height;
     }
@@ -349,7 +353,7 @@ void RP::TimingsBase::begin () {
         target->begin ();
     if (duration > 0) {
         steps = duration / 10; // 10/s updates
-        update_timer = document ()->post (this, new TimerPosting (100)); // 50ms
+        update_timer = document ()->post (this, new TimerPosting (100, 0, true)); // 50ms
         curr_step = 1;
     }
 }
@@ -159,7 +159,7 @@ static SMIL::Transition *findTransition (Node *n, const QString &id)
 
 static bool parseTransitionParam (Node *n, TransitionModule &m, Runtime *r,
         const TrieString &para, const QString &val) {
-    if (para == "transIn") {
+    if (para == Ids::attr_trans_in) {
         SMIL::Transition *t = findTransition (n, val);
         if (t) {
             m.trans_in = t;
@@ -167,7 +167,7 @@ static bool parseTransitionParam (Node *n, TransitionModule &m, Runtime *r,
         } else {
             qCWarning(LOG_KMPLAYER_COMMON) << "Transition " << val << " not found in head";
         }
-    } else if (para == "transOut") {
+    } else if (para == Ids::attr_trans_out) {
         m.trans_out = findTransition (n, val);
         if (!m.trans_out)
             qCWarning(LOG_KMPLAYER_COMMON) << "Transition " << val << " not found in head";
@@ -454,12 +454,11 @@ void setDurationItems (Node *n, const QString &s, Runtime::DurationItem *item) {
 static bool disabledByExpr (Runtime *rt) {
     bool b = false;
     if (!rt->expr.isEmpty ()) {
-        Expression* res = evaluateExpr(rt->expr.toUtf8(), "data");
+        Expression* res = compiledExpr(rt->expr, "data");
         if (res) {
             SMIL::Smil *smil = SMIL::Smil::findSmilNode (rt->element);
             res->setRoot (smil ? smil->state_node.ptr() : nullptr);
             b = !res->toBool ();
-            delete res;
         }
     }
     return b;
@@ -589,7 +588,7 @@ bool Runtime::parseParam (const TrieString & name, const QString & val) {
         Mrl *mrl = element->mrl ();
         if (mrl)
             mrl->title = val;
-    } else if (name == "endsync") {
+    } else if (name == Ids::attr_endsync) {
         if ((durTime ().durval == DurMedia || durTime ().durval == 0) &&
                 endTime ().durval == DurMedia) {
             Node *e = findLocalNodeById (element, val);
@@ -599,12 +598,12 @@ bool Runtime::parseParam (const TrieString & name, const QString & val) {
                 durations [(int) EndTime].durval = (Duration) MsgEventStopped;
             }
         }
-    } else if (name.startsWith ("repeat")) {
+    } else if (name.startsWith (Ids::attr_repeat)) {
         if (val.indexOf ("indefinite") > -1)
             repeat = repeat_count = DurIndefinite;
         else
             repeat = repeat_count = val.toInt ();
-    } else if (name.startsWith ("expr")) {
+    } else if (name.startsWith (Ids::attr_expr)) {
         expr = val;
     } else // TODO restart/restartDefault
         return false;
@@ -1060,11 +1059,11 @@ bool CalculatedSizer::setSizeParam(const TrieString &name, const QString &val) {
         right = val;
     } else if (name == Ids::attr_bottom) {
         bottom = val;
-    } else if (name == "regPoint") {
+    } else if (name == Ids::attr_reg_point) {
         reg_point = val;
-    } else if (name == "regAlign") {
+    } else if (name == Ids::attr_reg_align) {
         reg_align = val;
-    } else if (name == "mediaAlign") {
+    } else if (name == Ids::attr_media_align) {
         reg_point = val;
         reg_align = val;
     } else
@@ -1118,90 +1117,140 @@ ConnectionList *MouseListeners::receivers (MessageType eid) {
 
 //-----------------------------------------------------------------------------
 
-static Element * fromScheduleGroup (NodePtr & d, const QString & tag) {
-    QByteArray ba = tag.toLatin1 ();
-    const char *ctag = ba.constData ();
-    if (!strcmp (ctag, "par"))
+namespace {
+
+enum SmilTag {
+    tag_unknown = 0,
+    tag_a, tag_anchor, tag_animate, tag_animateColor, tag_animateMotion,
+    tag_animation, tag_area, tag_audio, tag_body, tag_br, tag_brush,
+    tag_clear, tag_data, tag_delvalue, tag_div, tag_excl, tag_head, tag_img,
+    tag_layout, tag_meta, tag_newvalue, tag_p, tag_par, tag_param,
+    tag_priorityClass, tag_ref, tag_regPoint, tag_region, tag_root_layout,
+    tag_send, tag_seq, tag_set, tag_setvalue, tag_smilText, tag_span,
+    tag_state, tag_switch, tag_tev, tag_text, tag_textstream, tag_title,
+    tag_transition, tag_video
+};
+
+}
+
+/**
+ * Maps an element name to its SmilTag, so childFromTag hashes the name once
+ * instead of running it through a strcmp chain for each element group.
+ */
+static SmilTag smilTag (const QString &tag) {
+    static const QHash <QString, SmilTag> tags {
+        { "a", tag_a }, { "anchor", tag_anchor }, { "animate", tag_animate },
+        { "animateColor", tag_animateColor },
+        { "animateMotion", tag_animateMotion },
+        { "animation", tag_animation }, { "area", tag_area },
+        { "audio", tag_audio }, { "body", tag_body }, { "br", tag_br },
+        { "brush", tag_brush }, { "clear", tag_clear }, { "data", tag_data },
+        { "delvalue", tag_delvalue }, { "div", tag_div }, { "excl", tag_excl },
+        { "head", tag_head }, { "img", tag_img }, { "layout", tag_layout },
+        { "meta", tag_meta }, { "newvalue", tag_newvalue }, { "p", tag_p },
+        { "par", tag_par }, { "param", tag_param },
+        { "priorityClass", tag_priorityClass }, { "ref", tag_ref },
+        { "regPoint", tag_regPoint }, { "region", tag_region },
+        { "root-layout", tag_root_layout }, { "send", tag_send },
+        { "seq", tag_seq }, { "set", tag_set }, { "setvalue", tag_setvalue },
+        { "smilText", tag_smilText }, { "span", tag_span },
+        { "state", tag_state }, { "switch", tag_switch }, { "tev", tag_tev },
+        { "text", tag_text }, { "textstream", tag_textstream },
+        { "title", tag_title }, { "transition", tag_transition },
+        { "video", tag_video }
+    };
+    return tags.value (tag, tag_unknown);
+}
+
+static Element * fromScheduleGroup (NodePtr & d, SmilTag tag) {
+    switch (tag) {
+    case tag_par:
         return new SMIL::Par (d);
-    else if (!strcmp (ctag, "seq"))
+    case tag_seq:
         return new SMIL::Seq (d);
-    else if (!strcmp (ctag, "excl"))
+    case tag_excl:
         return new SMIL::Excl (d);
-    return nullptr;
+    default:
+        return nullptr;
+    }
 }
 
-static Element * fromParamGroup (NodePtr & d, const QString & tag) {
-    QByteArray ba = tag.toLatin1 ();
-    const char *ctag = ba.constData ();
-    if (!strcmp (ctag, "param"))
+static Element * fromParamGroup (NodePtr & d, SmilTag tag, const QString & name) {
+    switch (tag) {
+    case tag_param:
         return new SMIL::Param (d);
-    else if (!strcmp (ctag, "area") || !strcmp (ctag, "anchor"))
-        return new SMIL::Area (d, tag);
-    return nullptr;
+    case tag_area:
+    case tag_anchor:
+        return new SMIL::Area (d, name);
+    default:
+        return nullptr;
+    }
 }
 
-static Element * fromAnimateGroup (NodePtr & d, const QString & tag) {
-    QByteArray ba = tag.toLatin1 ();
-    const char *ctag = ba.constData ();
-    if (!strcmp (ctag, "set"))
+static Element * fromAnimateGroup (NodePtr & d, SmilTag tag) {
+    switch (tag) {
+    case tag_set:
         return new SMIL::Set (d);
-    else if (!strcmp (ctag, "animate"))
+    case tag_animate:
         return new SMIL::Animate (d);
-    else if (!strcmp (ctag, "animateColor"))
+    case tag_animateColor:
         return new SMIL::AnimateColor (d);
-    else if (!strcmp (ctag, "animateMotion"))
+    case tag_animateMotion:
         return new SMIL::AnimateMotion (d);
-    else if (!strcmp (ctag, "newvalue"))
+    case tag_newvalue:
         return new SMIL::NewValue (d);
-    else if (!strcmp (ctag, "setvalue"))
+    case tag_setvalue:
         return new SMIL::SetValue (d);
-    else if (!strcmp (ctag, "delvalue"))
+    case tag_delvalue:
         return new SMIL::DelValue (d);
-    else if (!strcmp (ctag, "send"))
+    case tag_send:
         return new SMIL::Send (d);
-    return nullptr;
+    default:
+        return nullptr;
+    }
 }
 
-static Element * fromMediaContentGroup (NodePtr & d, const QString & tag) {
-    QByteArray ba = tag.toLatin1 ();
-    const char *taglatin = ba.constData ();
-    if (!strcmp (taglatin, "video") ||
-            !strcmp (taglatin, "audio") ||
-            !strcmp (taglatin, "img") ||
-            !strcmp (taglatin, "animation") ||
-            !strcmp (taglatin, "textstream") ||
-            !strcmp (taglatin, "ref"))
-        return new SMIL::RefMediaType (d, ba);
-    else if (!strcmp (taglatin, "text"))
+static Element * fromMediaContentGroup (NodePtr & d, SmilTag tag, const QString & name) {
+    switch (tag) {
+    case tag_video:
+    case tag_audio:
+    case tag_img:
+    case tag_animation:
+    case tag_textstream:
+    case tag_ref:
+        return new SMIL::RefMediaType (d, name.toLatin1 ());
+    case tag_text:
         return new SMIL::TextMediaType (d);
-    else if (!strcmp (taglatin, "brush"))
+    case tag_brush:
         return new SMIL::Brush (d);
-    else if (!strcmp (taglatin, "a"))
+    case tag_a:
         return new SMIL::Anchor (d);
-    else if (!strcmp (taglatin, "smilText"))
+    case tag_smilText:
         return new SMIL::SmilText (d);
-    // animation, textstream
-    return nullptr;
+    default:
+        return nullptr;
+    }
 }
 
-static Element * fromContentControlGroup (NodePtr & d, const QString & tag) {
-    if (!strcmp (tag.toLatin1 ().constData (), "switch"))
+static Element * fromContentControlGroup (NodePtr & d, SmilTag tag) {
+    if (tag_switch == tag)
         return new SMIL::Switch (d);
     return nullptr;
 }
 
-static Element *fromTextFlowGroup (NodePtr &d, const QString &tag) {
-    QByteArray ba = tag.toLatin1 ();
-    const char *taglatin = ba.constData ();
-    if (!strcmp (taglatin, "div"))
-        return new SMIL::TextFlow (d, SMIL::id_node_div, tag.toUtf8 ());
-    if (!strcmp (taglatin, "span"))
-        return new SMIL::TextFlow (d, SMIL::id_node_span, tag.toUtf8 ());
-    if (!strcmp (taglatin, "p"))
-        return new SMIL::TextFlow (d, SMIL::id_node_p, tag.toUtf8 ());
-    if (!strcmp (taglatin, "br"))
-        return new SMIL::TextFlow (d, SMIL::id_node_br, tag.toUtf8 ());
-    return nullptr;
+static Element *fromTextFlowGroup (NodePtr &d, SmilTag tag, const QString &name) {
+    switch (tag) {
+    case tag_div:
+        return new SMIL::TextFlow (d, SMIL::id_node_div, name.toUtf8 ());
+    case tag_span:
+        return new SMIL::TextFlow (d, SMIL::id_node_span, name.toUtf8 ());
+    case tag_p:
+        return new SMIL::TextFlow (d, SMIL::id_node_p, name.toUtf8 ());
+    case tag_br:
+        return new SMIL::TextFlow (d, SMIL::id_node_br, name.toUtf8 ());
+    default:
+        return nullptr;
+    }
 }
 
 static unsigned int setRGBA (unsigned int color, int opacity) {
@@ -1240,9 +1289,9 @@ void SmilColorProperty::setOpacity (const QString &val)
 
 static bool parseBackgroundParam (SmilColorProperty &p, const TrieString &name, const QString &val)
 {
-    if (name == "background-color" || name == "backgroundColor")
+    if (name == Ids::attr_background_color_smil1 || name == Ids::attr_background_color)
         p.setColor (val);
-    else if (name == "backgroundOpacity")
+    else if (name == Ids::attr_background_opacity)
         p.setOpacity (val);
     else
         return false;
@@ -1254,9 +1303,9 @@ void MediaOpacity::init () {
 }
 
 static bool parseMediaOpacityParam (MediaOpacity &p, const TrieString &name, const QString &val) {
-    if (name == "mediaOpacity")
+    if (name == Ids::attr_media_opacity)
         p.opacity = (int) SizeType (val, true).size (100);
-    else if (name == "mediaBackgroundOpacity")
+    else if (name == Ids::attr_media_background_opacity)
         p.bg_opacity = (int) SizeType (val, true).size (100);
     else
         return false;
@@ -1367,13 +1416,14 @@ void TransitionModule::finish (Node *n) {
 //-----------------------------------------------------------------------------
 
 Node *SMIL::Smil::childFromTag (const QString & tag) {
-    QByteArray ba = tag.toLatin1 ();
-    const char *ctag = ba.constData ();
-    if (!strcmp (ctag, "body"))
+    switch (smilTag (tag)) {
+    case tag_body:
         return new SMIL::Body (m_doc);
-    else if (!strcmp (ctag, "head"))
+    case tag_head:
         return new SMIL::Head (m_doc);
-    return nullptr;
+    default:
+        return nullptr;
+    }
 }
 
 void SMIL::Smil::activate () {
@@ -1484,13 +1534,11 @@ SMIL::Smil * SMIL::Smil::findSmilNode (Node * node) {
 }
 
 static QString exprStringValue (Node *node, const QString &str) {
-    Expression* res = evaluateExpr(str.toUtf8(), "data");
+    Expression* res = compiledExpr(str, "data");
     if (res) {
         SMIL::Smil *smil = SMIL::Smil::findSmilNode (node);
         res->setRoot (smil ? smil->state_node.ptr() : nullptr);
-        QString s = res->toString();
-        delete res;
-        return s;
+        return res->toString();
     }
     return str;
 }
@@ -1512,19 +1560,20 @@ static void headChildDone (Node *node, Node *child) {
 }
 
 Node *SMIL::Head::childFromTag (const QString & tag) {
-    QByteArray ba = tag.toLatin1 ();
-    const char *ctag = ba.constData ();
-    if (!strcmp (ctag, "layout"))
+    switch (smilTag (tag)) {
+    case tag_layout:
         return new SMIL::Layout (m_doc);
-    else if (!strcmp (ctag, "title"))
-        return new DarkNode (m_doc, ctag, id_node_title);
-    else if (!strcmp (ctag, "meta"))
-        return new DarkNode (m_doc, ctag, id_node_meta);
-    else if (!strcmp (ctag, "state"))
+    case tag_title:
+        return new DarkNode (m_doc, "title", id_node_title);
+    case tag_meta:
+        return new DarkNode (m_doc, "meta", id_node_meta);
+    case tag_state:
         return new SMIL::State (m_doc);
-    else if (!strcmp (ctag, "transition"))
+    case tag_transition:
         return new SMIL::Transition (m_doc);
-    return nullptr;
+    default:
+        return nullptr;
+    }
 }
 
 void SMIL::Head::closed () {
@@ -1552,7 +1601,7 @@ SMIL::State::State (NodePtr &d)
  : Element (d, id_node_state), media_info (nullptr) {}
 
 Node *SMIL::State::childFromTag (const QString &tag) {
-    if (tag == "data")
+    if (tag_data == smilTag (tag))
         return new DarkNode (m_doc, tag.toUtf8 (), SMIL::id_node_state_data);
     return nullptr;
 }
@@ -1617,6 +1666,9 @@ void SMIL::State::stateChanged (Node *ref) {
     for (; c; c = m_StateChangeListeners.next ()) {
         if (c->payload && c->connecter) {
             Expression *expr = (Expression *) c->payload;
+            if (!expr->dependsOn (ref))
+                continue; // last evaluation didn't touch ref
+            expr->trackDependencies ();
             expr->setRoot (this);
             Expression::iterator it, e = expr->end();
             for (it = expr->begin(); it != e; ++it) {
@@ -1693,17 +1745,19 @@ SMIL::Layout::Layout (NodePtr & d)
  : Element (d, id_node_layout) {}
 
 Node *SMIL::Layout::childFromTag (const QString & tag) {
-    QByteArray ba = tag.toLatin1 ();
-    const char *ctag = ba.constData ();
-    if (!strcmp (ctag, "root-layout")) {
+    switch (smilTag (tag)) {
+    case tag_root_layout: {
         Node *e = new SMIL::RootLayout (m_doc);
         root_layout = e;
         return e;
-    } else if (!strcmp (ctag, "region"))
+    }
+    case tag_region:
         return new SMIL::Region (m_doc);
-    else if (!strcmp (ctag, "regPoint"))
+    case tag_regPoint:
         return new SMIL::RegPoint (m_doc);
-    return nullptr;
+    default:
+        return nullptr;
+    }
 }
 
 void SMIL::Layout::closed () {
@@ -1851,7 +1905,7 @@ void SMIL::RegionBase::parseParam (const TrieString & name, const QString & val)
         }
     } else if (parseBackgroundParam (background_color, name, val) ||
             parseMediaOpacityParam (media_opacity, name, val)) {
-    } else if (name == "z-index") {
+    } else if (name == Ids::attr_z_index) {
         z_order = val.toInt ();
         if (region_surface)
             updateSurfaceSort (this);
@@ -1859,13 +1913,13 @@ void SMIL::RegionBase::parseParam (const TrieString & name, const QString & val)
     } else if (sizes.setSizeParam (name, val)) {
         if (state_finished == state && region_surface)
             message (MsgSurfaceBoundsUpdate);
-    } else if (name == "showBackground") {
+    } else if (name == Ids::attr_show_background) {
         if (val == "whenActive")
             show_background = ShowWhenActive;
         else
             show_background = ShowAlways;
         need_repaint = true;
-    } else if (name == "backgroundRepeat") {
+    } else if (name == Ids::attr_background_repeat) {
         if (val == "noRepeat")
             bg_repeat = BgNoRepeat;
         else if (val == "repeatX")
@@ -1876,7 +1930,7 @@ void SMIL::RegionBase::parseParam (const TrieString & name, const QString & val)
             bg_repeat = BgInherit;
         else
             bg_repeat = BgRepeat;
-    } else if (name == "backgroundImage") {
+    } else if (name == Ids::attr_background_image) {
         if (val.isEmpty () || val == "none" || val == "inherit") {
             need_repaint = !background_image.isEmpty () &&
                 background_image != val;
@@ -2069,7 +2123,7 @@ void SMIL::Region::deactivate () {
 }
 
 Node *SMIL::Region::childFromTag (const QString & tag) {
-    if (!strcmp (tag.toLatin1 ().constData (), "region"))
+    if (tag_region == smilTag (tag))
         return new SMIL::Region (m_doc);
     return nullptr;
 }
@@ -2250,10 +2304,11 @@ SMIL::GroupBase::~GroupBase () {
 }
 
 Node *SMIL::GroupBase::childFromTag (const QString & tag) {
-    Element * elm = fromScheduleGroup (m_doc, tag);
-    if (!elm) elm = fromMediaContentGroup (m_doc, tag);
-    if (!elm) elm = fromContentControlGroup (m_doc, tag);
-    if (!elm) elm = fromAnimateGroup (m_doc, tag);
+    SmilTag id = smilTag (tag);
+    Element * elm = fromScheduleGroup (m_doc, id);
+    if (!elm) elm = fromMediaContentGroup (m_doc, id, tag);
+    if (!elm) elm = fromContentControlGroup (m_doc, id);
+    if (!elm) elm = fromAnimateGroup (m_doc, id);
     if (elm)
         return elm;
     return nullptr;
@@ -2318,6 +2373,47 @@ public:
     }
 };
 
+/*
+ * Seq children are prefetched ahead of their begin, so that a slideshow
+ * doesn't wait for a download at each item. Besides the sibling following
+ * the current child, siblings are prefetched as long as they begin within
+ * the lookahead window going by begin offsets and timer durations, bounded
+ * by a maximum number of items ahead.
+ */
+static const int seq_prefetch_window = 1000; // centisec
+static const int seq_prefetch_max = 4;
+
+static int expectedSpan (Node *n) {
+    Runtime *rt = (Runtime *) n->role (RoleTiming);
+    if (!rt)
+        return 0;
+    if (Runtime::DurTimer == rt->beginTime ().durval &&
+            Runtime::DurTimer == rt->durTime ().durval &&
+            rt->durTime ().offset > 0)
+        return rt->beginTime ().offset + rt->durTime ().offset;
+    return -1; // event based or media duration
+}
+
+static void prefetchAhead (Node *current) {
+    int begin_at = 0;
+    int fetched = 0;
+    for (Node *n = current; n && fetched < seq_prefetch_max; ) {
+        int span = expectedSpan (n);
+        if (span < 0) {
+            if (fetched)
+                break;
+            span = 0; // always prefetch the next sibling
+        }
+        begin_at += span;
+        n = n->nextSibling ();
+        if (!n || (fetched && begin_at > seq_prefetch_window))
+            break;
+        GroupBaseInitVisitor visitor;
+        n->accept (&visitor);
+        ++fetched;
+    }
+}
+
 class FreezeStateUpdater : public Visitor {
 
     bool initial_node;
@@ -2635,10 +2731,7 @@ void SMIL::Seq::begin () {
                     rt->timingstate = Runtime::timings_stopped; //TODO fill_hold
             }
     } else if (firstChild ()) {
-        if (firstChild ()->nextSibling()) {
-            GroupBaseInitVisitor visitor;
-            firstChild ()->nextSibling ()->accept (&visitor);
-        }
+        prefetchAhead (firstChild ());
         starting_connection.connect (firstChild (), MsgEventStarted, this);
         firstChild ()->activate ();
     }
@@ -2669,10 +2762,7 @@ void SMIL::Seq::message (MessageType msg, void *content) {
                         ? post->source->nextSibling ()
                         : nullptr;
                     if (next) {
-                        if (next->nextSibling()) {
-                            GroupBaseInitVisitor visitor;
-                            next->nextSibling ()->accept (&visitor);
-                        }
+                        prefetchAhead (next);
                         starting_connection.connect(next, MsgEventStarted,this);
                         trans_connection.connect (
                                 next, MsgChildTransformedIn, this);
@@ -2732,7 +2822,7 @@ void *SMIL::Seq::role (RoleType msg, void *content) {
 //-----------------------------------------------------------------------------
 
 Node *SMIL::Excl::childFromTag (const QString &tag) {
-    if (tag == "priorityClass")
+    if (tag_priorityClass == smilTag (tag))
         return new PriorityClass (m_doc);
     return GroupBase::childFromTag (tag);
 }
@@ -2965,10 +3055,11 @@ void SMIL::Excl::message (MessageType msg, void *content) {
 //-----------------------------------------------------------------------------
 
 Node *SMIL::PriorityClass::childFromTag (const QString &tag) {
-    Element * elm = fromScheduleGroup (m_doc, tag);
-    if (!elm) elm = fromMediaContentGroup (m_doc, tag);
-    if (!elm) elm = fromContentControlGroup (m_doc, tag);
-    if (!elm) elm = fromAnimateGroup (m_doc, tag);
+    SmilTag id = smilTag (tag);
+    Element * elm = fromScheduleGroup (m_doc, id);
+    if (!elm) elm = fromMediaContentGroup (m_doc, id, tag);
+    if (!elm) elm = fromContentControlGroup (m_doc, id);
+    if (!elm) elm = fromAnimateGroup (m_doc, id);
     if (elm)
         return elm;
     return nullptr;
@@ -3184,7 +3275,7 @@ void SMIL::Anchor::message (MessageType msg, void *content) {
 }
 
 Node *SMIL::Anchor::childFromTag (const QString & tag) {
-    return fromMediaContentGroup (m_doc, tag);
+    return fromMediaContentGroup (m_doc, smilTag (tag), tag);
 }
 
 void *SMIL::Anchor::role (RoleType msg, void *content) {
@@ -3254,9 +3345,10 @@ SMIL::MediaType::~MediaType () {
 }
 
 Node *SMIL::MediaType::childFromTag (const QString & tag) {
-    Element * elm = fromContentControlGroup (m_doc, tag);
-    if (!elm) elm = fromParamGroup (m_doc, tag);
-    if (!elm) elm = fromAnimateGroup (m_doc, tag);
+    SmilTag id = smilTag (tag);
+    Element * elm = fromContentControlGroup (m_doc, id);
+    if (!elm) elm = fromParamGroup (m_doc, id, tag);
+    if (!elm) elm = fromAnimateGroup (m_doc, id);
     if (elm)
         return elm;
     return nullptr;
@@ -3304,7 +3396,7 @@ void SMIL::MediaType::parseParam (const TrieString &para, const QString & val) {
             message (MsgSurfaceBoundsUpdate);
     } else if (para == Ids::attr_type) {
         mimetype = val;
-    } else if (para == "panZoom") {
+    } else if (para == Ids::attr_pan_zoom) {
         QStringList coords = val.split (QChar (','));
         if (coords.size () < 4) {
             qCWarning(LOG_KMPLAYER_COMMON) << "panZoom less then four nubmers";
@@ -3318,10 +3410,10 @@ void SMIL::MediaType::parseParam (const TrieString &para, const QString & val) {
         pan_zoom->height = coords[3];
     } else if (parseBackgroundParam (background_color, para, val) ||
             parseMediaOpacityParam (media_opacity, para, val)) {
-    } else if (para == "system-bitrate") {
+    } else if (para == Ids::attr_system_bitrate) {
         bitrate = val.toInt ();
     } else if (parseTransitionParam (this, transition, runtime, para, val)) {
-    } else if (para == "sensitivity") {
+    } else if (para == Ids::attr_sensitivity) {
         if (val == "transparent")
             sensitivity = sens_transparent;
         //else if (val == "percentage") // TODO
@@ -3839,6 +3931,14 @@ void SMIL::RefMediaType::message (MessageType msg, void *content) {
         switch (msg) {
 
         case MsgMediaUpdated: {
+            // without a size in the header, it's only known once decoded
+            ImageMedia *im = static_cast <ImageMedia *> (media_info->media);
+            SSize sz;
+            im->sizes (sz);
+            if (!sz.isEmpty () && sz != size) {
+                size = sz;
+                message (MsgSurfaceBoundsUpdate, (void *) true);
+            }
             Surface *s = surface ();
             if (s) {
                 s->markDirty ();
@@ -3856,7 +3956,7 @@ void SMIL::RefMediaType::message (MessageType msg, void *content) {
         case MsgMediaReady:
             if (media_info) {
                 ImageMedia *im = static_cast <ImageMedia *> (media_info->media);
-                if (im && !im->isEmpty ())
+                if (im && (!im->isEmpty () || im->decoding ()))
                     im->sizes (size);
             }
             break;
@@ -4055,13 +4155,12 @@ void SMIL::SmilText::reset () {
 }
 
 Node *SMIL::SmilText::childFromTag (const QString &tag) {
-    QByteArray ba = tag.toLatin1 ();
-    const char *ctag = ba.constData ();
-    if (!strcmp (ctag, "tev"))
-        return new TemporalMoment (m_doc, id_node_tev, ba);
-    if (!strcmp (ctag, "clear"))
-        return new TemporalMoment (m_doc, id_node_clear, ba);
-    return fromTextFlowGroup (m_doc, tag);
+    SmilTag id = smilTag (tag);
+    if (tag_tev == id)
+        return new TemporalMoment (m_doc, id_node_tev, tag.toLatin1 ());
+    if (tag_clear == id)
+        return new TemporalMoment (m_doc, id_node_clear, tag.toLatin1 ());
+    return fromTextFlowGroup (m_doc, id, tag);
 }
 
 void SMIL::SmilText::parseParam (const TrieString &name, const QString &value) {
@@ -4296,7 +4395,7 @@ void SMIL::TextFlow::activate () {
 }
 
 Node *SMIL::TextFlow::childFromTag (const QString &tag) {
-    return fromTextFlowGroup (m_doc, tag);
+    return fromTextFlowGroup (m_doc, smilTag (tag), tag);
 }
 
 void SMIL::TextFlow::parseParam(const TrieString &name, const QString &val) {
@@ -4337,7 +4436,7 @@ void SMIL::TemporalMoment::deactivate () {
 }
 
 Node *SMIL::TemporalMoment::childFromTag (const QString & tag) {
-    return fromTextFlowGroup (m_doc, tag);
+    return fromTextFlowGroup (m_doc, smilTag (tag), tag);
 }
 
 void SMIL::TemporalMoment::parseParam (const TrieString &name, const QString &value) {
@@ -4804,6 +4903,7 @@ SMIL::AnimateBase::AnimateBase (NodePtr &d, short id)
    anim_timer (nullptr),
    keytimes (nullptr),
    spline_table (nullptr),
+   spline_count (0),
    keytime_count (0) {}
 
 SMIL::AnimateBase::~AnimateBase () {
@@ -4832,6 +4932,7 @@ void SMIL::AnimateBase::init () {
         if (spline_table)
             free (spline_table);
         spline_table = nullptr;
+        spline_count = 0;
         splines.clear ();
         AnimateGroup::init ();
     }
@@ -4839,8 +4940,11 @@ void SMIL::AnimateBase::init () {
 
 void SMIL::AnimateBase::begin () {
     interval = 0;
+    if (calc_spline == calcMode && !spline_table)
+        buildSplineTables ();
     if (!setInterval ())
         return;
+    applied_value.clear ();
     applyStep ();
     if (calc_discrete != calcMode)
         change_updater.connect (m_doc, MsgSurfaceUpdate, this);
@@ -4866,6 +4970,7 @@ void SMIL::AnimateBase::deactivate () {
     if (spline_table)
         free (spline_table);
     spline_table = nullptr;
+    spline_count = 0;
     AnimateGroup::deactivate ();
 }
 
@@ -4964,17 +5069,70 @@ static SMIL::AnimateBase::Point2D cubicBezier (float ax, float bx, float cx,
 }
 
 static
-float cubicBezier (SMIL::AnimateBase::Point2D *table, int a, int b, float x) {
-    if (b > a + 1) {
+float cubicBezier (const SMIL::AnimateBase::Point2D *table, int a, int b, float x) {
+    while (b > a + 1) {
         int mid = (a + b) / 2;
         if (table[mid].x > x)
-            return cubicBezier (table, a, mid, x);
+            b = mid;
         else
-            return cubicBezier (table, mid, b, x);
+            a = mid;
     }
     return table[a].y + (x - table[a].x) / (table[b].x - table[a].x) * (table[b].y - table[a].y);
 }
 
+static const int spline_steps = 100;
+
+/*
+ * Sample all keySplines once when the animation begins, instead of
+ * parsing and sampling the next one on each interval.
+ */
+void SMIL::AnimateBase::buildSplineTables () {
+    spline_count = splines.size ();
+    if (!spline_count)
+        return;
+    spline_table = (Point2D *) malloc (spline_count * spline_steps * sizeof (Point2D));
+    for (unsigned int s = 0; s < spline_count; ++s) {
+        float control_point[4] = { 0, 0, 1, 1 };
+        QStringList kss = splines[s].split (QChar (' '));
+        if (kss.size () == 4) {
+            for (int i = 0; i < 4; ++i) {
+                control_point[i] = kss[i].toDouble();
+                if (control_point[i] < 0 || control_point[i] > 1) {
+                    qCWarning(LOG_KMPLAYER_COMMON) << "keySplines values not between 0-1"
+                        << endl;
+                    control_point[i] = i > 1 ? 1 : 0;
+                    break;
+                }
+            }
+        } else {
+            qCWarning(LOG_KMPLAYER_COMMON) << "keySplines " << s <<
+                " has not 4 values" << endl;
+        }
+
+        /* calculate the polynomial coefficients */
+        float ax, bx, cx;
+        float ay, by, cy;
+        cx = 3.0 * control_point[0];
+        bx = 3.0 * (control_point[2] - control_point[0]) - cx;
+        ax = 1.0 - cx - bx;
+
+        cy = 3.0 * control_point[1];
+        by = 3.0 * (control_point[3] - control_point[1]) - cy;
+        ay = 1.0 - cy - by;
+
+        Point2D *table = spline_table + s * spline_steps;
+        for (int i = 0; i < spline_steps; ++i)
+            table[i] = cubicBezier (ax, bx, cx, ay, by, cy, 1.0*i/spline_steps);
+    }
+}
+
+float SMIL::AnimateBase::ease (float gain) const {
+    if (calc_spline == calcMode && interval < spline_count)
+        return cubicBezier (spline_table + interval * spline_steps,
+                0, spline_steps - 1, gain);
+    return gain;
+}
+
 
 bool SMIL::AnimateBase::setInterval () {
     int cs = runtime->durTime ().offset;
@@ -4997,48 +5155,11 @@ bool SMIL::AnimateBase::setInterval () {
     switch (calcMode) {
         case calc_paced: // FIXME
         case calc_linear:
-            break;
         case calc_spline:
-            if (splines.size () > (int)interval) {
-                QStringList kss = splines[interval].split (QChar (' '));
-                control_point[0] = control_point[1] = 0;
-                control_point[2] = control_point[3] = 1;
-                if (kss.size () == 4) {
-                    for (int i = 0; i < 4; ++i) {
-                        control_point[i] = kss[i].toDouble();
-                        if (control_point[i] < 0 || control_point[i] > 1) {
-                            qCWarning(LOG_KMPLAYER_COMMON) << "keySplines values not between 0-1"
-                                << endl;
-                            control_point[i] = i > 1 ? 1 : 0;
-                            break;
-                        }
-                    }
-                    if (spline_table)
-                        free (spline_table);
-                    spline_table = (Point2D *) malloc (100 * sizeof (Point2D));
-
-                    /* calculate the polynomial coefficients */
-                    float ax, bx, cx;
-                    float ay, by, cy;
-                    cx = 3.0 * control_point[0];
-                    bx = 3.0 * (control_point[2] - control_point[0]) - cx;
-                    ax = 1.0 - cx - bx;
-
-                    cy = 3.0 * control_point[1];
-                    by = 3.0 * (control_point[3] - control_point[1]) - cy;
-                    ay = 1.0 - cy - by;
-
-                    for (int i = 0; i < 100; ++i)
-                        spline_table[i] = cubicBezier (ax, bx, cx, ay, by, cy, 1.0*i/100);
-                } else {
-                    qCWarning(LOG_KMPLAYER_COMMON) << "keySplines " << interval <<
-                        " has not 4 values" << endl;
-                }
-            }
             break;
         case calc_discrete:
             anim_timer = document ()->post (this,
-                    new TimerPosting (10 * cs, anim_timer_id));
+                    new TimerPosting (10 * cs, anim_timer_id, true));
             break;
         default:
             break;
@@ -5054,7 +5175,8 @@ bool SMIL::AnimateBase::setInterval () {
 
 SMIL::Animate::Animate (NodePtr &doc)
  : AnimateBase (doc, id_node_animate),
-   num_count (0), begin_(nullptr), cur (nullptr), delta (nullptr), end (nullptr) {
+   num_count (0), begin_(nullptr), cur (nullptr), delta (nullptr), end (nullptr),
+   keyvalues (nullptr) {
 }
 
 void SMIL::Animate::init () {
@@ -5073,7 +5195,8 @@ void SMIL::Animate::cleanUp () {
     delete [] cur;
     delete [] delta;
     delete [] end;
-    begin_ = cur = delta = end = nullptr;
+    delete [] keyvalues;
+    begin_ = cur = delta = end = keyvalues = nullptr;
     num_count = 0;
 }
 
@@ -5111,17 +5234,26 @@ void SMIL::Animate::begin () {
         return;
     }
     if (calcMode != calc_discrete) {
-        QStringList bnums = values[0].split (QString (","));
-        QStringList enums = values[1].split (QString (","));
-        num_count = bnums.size ();
+        num_count = values[0].split (QString (",")).size ();
         if (num_count) {
+            // parse all key values once, missing numbers repeat the previous
+            keyvalues = new SizeType [values.size () * num_count];
+            for (int v = 0; v < values.size (); ++v) {
+                QStringList nums = values[v].split (QString (","));
+                SizeType *row = keyvalues + v * num_count;
+                for (int i = 0; i < num_count; ++i)
+                    if (i < nums.size ())
+                        row[i] = nums[i];
+                    else
+                        row[i] = row[i - num_count];
+            }
             begin_ = new SizeType [num_count];
             end = new SizeType [num_count];
             cur = new SizeType [num_count];
             delta = new SizeType [num_count];
             for (int i = 0; i < num_count; ++i) {
-                begin_[i] = bnums[i];
-                end[i] = i < enums.size () ? enums[i] : bnums[i];
+                begin_[i] = keyvalues[i];
+                end[i] = keyvalues[num_count + i];
                 cur[i] = begin_[i];
                 delta[i] = end[i];
                 delta[i] -= begin_[i];
@@ -5151,7 +5283,11 @@ void SMIL::Animate::applyStep () {
                 QString val (cur[0].toString ());
                 for (int i = 1; i < num_count; ++i)
                     val += QChar (',') + cur[i].toString ();
-                target->setParam (changed_attribute, val, &modification_id);
+                // slow animations often round to the same value several ticks
+                if (val != applied_value) {
+                    applied_value = val;
+                    target->setParam (changed_attribute, val, &modification_id);
+                }
             }
         } else if ((int)interval < values.size ()) {
             target->setParam (changed_attribute,
@@ -5173,8 +5309,7 @@ bool SMIL::Animate::timerTick (unsigned int cur_time) {
             case calc_linear:
                 break;
             case calc_spline:
-                if (spline_table)
-                    gain = cubicBezier (spline_table, 0, 99, gain);
+                gain = ease (gain);
                 break;
             case calc_discrete:
                 return false; // shouldn't come here
@@ -5190,11 +5325,10 @@ bool SMIL::Animate::timerTick (unsigned int cur_time) {
         if (calc_discrete != calcMode) {
             if (values.size () <= (int) interval + 1)
                 return false;
-            QStringList enums = values[interval+1].split (QString (","));
+            const SizeType *row = keyvalues + (interval + 1) * num_count;
             for (int i = 0; i < num_count; ++i) {
                 begin_[i] = end[i];
-                if (i < enums.size ())
-                    end[i] = enums[i];
+                end[i] = row[i];
                 cur[i] = begin_[i];
                 delta[i] = end[i];
                 delta[i] -= begin_[i];
@@ -5325,8 +5459,7 @@ bool SMIL::AnimateMotion::timerTick (unsigned int cur_time) {
             case calc_linear:
                 break;
             case calc_spline:
-                if (spline_table)
-                    gain = cubicBezier (spline_table, 0, 99, gain);
+                gain = ease (gain);
                 break;
             case calc_discrete:
                 return false; // shouldn't come here
@@ -5473,7 +5606,10 @@ void SMIL::AnimateColor::applyStep () {
     if (target) {
         // TODO make more efficient
         const  QString val = QString::asprintf ("#%08x", cur_c.argb ());
-        static_cast <Element *> (target)->setParam (changed_attribute, val);
+        if (val != applied_value) {
+            applied_value = val;
+            static_cast <Element *> (target)->setParam (changed_attribute, val);
+        }
     }
 }
 
@@ -5490,8 +5626,7 @@ bool SMIL::AnimateColor::timerTick (unsigned int cur_time) {
             case calc_linear:
                 break;
             case calc_spline:
-                if (spline_table)
-                    gain = cubicBezier (spline_table, 0, 99, gain);
+                gain = ease (gain);
                 break;
             case calc_discrete:
                 return true; // shouldn't come here
@@ -1020,6 +1020,7 @@ protected:
     virtual void applyStep () = 0;
 
     bool setInterval ();
+    float ease (float gain) const;
 
     enum { acc_none, acc_sum } accumulate;
     enum { add_replace, add_sum } additive;
@@ -1028,15 +1029,18 @@ protected:
     QString change_by;
     QStringList values;
     ConnectionLink change_updater;
+    QString applied_value;
     float *keytimes;
-    Point2D *spline_table;
+    Point2D *spline_table; // spline_steps points per keySplines interval
     QStringList splines;
-    float control_point[4];
+    unsigned int spline_count;
     unsigned int keytime_count;
-    unsigned int keytime_steps;
     unsigned int interval;
     unsigned int interval_start_time;
     unsigned int interval_end_time;
+
+private:
+    void buildSplineTables ();
 };
 
 class Animate : public AnimateBase
@@ -1062,6 +1066,7 @@ private:
     SizeType *cur;
     SizeType *delta;
     SizeType *end;
+    SizeType *keyvalues; // num_count numbers for each of values
 };
 
 class AnimateMotion : public AnimateBase
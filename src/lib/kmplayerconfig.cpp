@@ -131,6 +131,10 @@ static const char * strRememberSize = "Remember Size";
 static const char * strAutoResize = "Auto Resize";
 static const char * strDockSysTray = "Dock in System Tray";
 static const char * strNoIntro = "No Intro";
+static const char * strPrestartBackend = "Prestart Backend";
+static const char * strMemoryCacheSize = "Memory Cache Size";
+static const char * strDiskCacheSize = "Disk Cache Size";
+static const char * strProgressUpdates = "Progress Updates Per Second";
 static const char * strVolume = "Volume";
 static const char * strContrast = "Contrast";
 static const char * strBrightness = "Brightness";
@@ -272,6 +276,10 @@ View * Settings::defaultView () {
 void Settings::readConfig () {
     KConfigGroup general (m_config, strGeneralGroup);
     no_intro = general.readEntry (strNoIntro, false);
+    prestartbackend = general.readEntry (strPrestartBackend, false);
+    memorycachesize = general.readEntry (strMemoryCacheSize, 32);
+    diskcachesize = general.readEntry (strDiskCacheSize, 256);
+    progressupdates = general.readEntry (strProgressUpdates, 25);
     urllist = general.readEntry (strURLList, QStringList());
     sub_urllist = general.readEntry (strSubURLList, QStringList());
     prefbitrate = general.readEntry (strPrefBitRate, 512);
@@ -425,6 +433,7 @@ void Settings::show (const char * pagename) {
     configdialog->m_GeneralPageGeneral->framedrop->setChecked (framedrop);
     configdialog->m_GeneralPageGeneral->adjustvolume->setChecked (autoadjustvolume);
     configdialog->m_GeneralPageGeneral->adjustcolors->setChecked (autoadjustcolors);
+    configdialog->m_GeneralPageGeneral->prestartBackend->setChecked (prestartbackend);
     //configdialog->m_GeneralPageGeneral->autoHideSlider->setChecked (autohideslider);
     configdialog->m_GeneralPageGeneral->showConfigButton->setChecked (showcnfbutton);
     configdialog->m_GeneralPageGeneral->showPlaylistButton->setChecked (showplaylistbutton);
@@ -536,6 +545,10 @@ void Settings::writeConfig () {
     KConfigGroup gen_cfg (m_config, strGeneralGroup);
     gen_cfg.writeEntry (strURLList, urllist);
     gen_cfg.writeEntry (strSubURLList, sub_urllist);
+    gen_cfg.writeEntry (strPrestartBackend, prestartbackend);
+    gen_cfg.writeEntry (strMemoryCacheSize, memorycachesize);
+    gen_cfg.writeEntry (strDiskCacheSize, diskcachesize);
+    gen_cfg.writeEntry (strProgressUpdates, progressupdates);
     gen_cfg.writeEntry (strPrefBitRate, prefbitrate);
     gen_cfg.writeEntry (strMaxBitRate, maxbitrate);
     gen_cfg.writeEntry (strVolume, volume);
@@ -686,6 +699,7 @@ void Settings::okPressed () {
     framedrop = configdialog->m_GeneralPageGeneral->framedrop->isChecked ();
     autoadjustvolume = configdialog->m_GeneralPageGeneral->adjustvolume->isChecked ();
     autoadjustcolors = configdialog->m_GeneralPageGeneral->adjustcolors->isChecked ();
+    prestartbackend = configdialog->m_GeneralPageGeneral->prestartBackend->isChecked ();
     showcnfbutton = configdialog->m_GeneralPageGeneral->showConfigButton->isChecked ();
     showplaylistbutton = configdialog->m_GeneralPageGeneral->showPlaylistButton->isChecked ();
     showrecordbutton = configdialog->m_GeneralPageGeneral->showRecordButton->isChecked ();
@@ -112,8 +112,12 @@ public:
     int saturation;
     int prefbitrate;
     int maxbitrate;
+    int memorycachesize; // MB of downloaded data kept in memory
+    int diskcachesize; // MB of downloaded data stored on disk
+    int progressupdates; // position/loaded updates per second shown
     bool usearts : 1;
     bool no_intro : 1;
+    bool prestartbackend : 1;
     bool sizeratio : 1;
     bool remembersize : 1;
     bool autoresize : 1;
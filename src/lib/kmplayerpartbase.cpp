@@ -97,11 +97,16 @@ PartBase::PartBase (QWidget * wparent, QObject * parent, KSharedConfigPtr config
    m_bookmark_menu (nullptr),
    m_update_tree_timer (0),
    m_rec_timer (0),
+   m_progress_timer (0),
+   m_pending_position (0),
+   m_pending_length (0),
+   m_pending_loaded (-1),
    m_noresize (false),
    m_auto_controls (true),
    m_bPosSliderPressed (false),
    m_in_update_tree (false),
-   m_update_tree_full (false)
+   m_update_tree_full (false),
+   m_position_pending (false)
 {
     m_sources ["urlsource"] = new URLSource (this);
 
@@ -258,6 +263,10 @@ QString PartBase::doEvaluate (const QString &) {
 }
 
 void PartBase::settingsChanged () {
+    m_media_manager->memoryCache ()->setMaxSize (
+            qint64 (m_settings->memorycachesize) * 1024 * 1024);
+    m_media_manager->diskCache ()->setMaxSize (
+            qint64 (m_settings->diskcachesize) * 1024 * 1024);
     if (!m_view)
         return;
     if (m_settings->showcnfbutton)
@@ -273,6 +282,16 @@ void PartBase::settingsChanged () {
         m_view->controlPanel ()->broadcastButton ()->hide ();
     keepMovieAspect (m_settings->sizeratio);
     m_settings->applyColorSetting (true);
+    prestartBackend ();
+}
+
+void PartBase::prestartBackend () {
+    if (m_settings->prestartbackend) {
+        ProcessInfo *pi = m_media_manager->processInfos ().value (
+                m_settings->backends ["urlsource"]);
+        if (pi)
+            pi->prestart ();
+    }
 }
 
 KMediaPlayer::View* PartBase::view () {
@@ -518,6 +537,21 @@ void PartBase::timerEvent (QTimerEvent * e) {
         m_rec_timer = 0;
         if (m_record_doc)
             openUrl(QUrl::fromUserInput(convertNode <RecordDocument> (m_record_doc)->record_file));
+    } else if (e->timerId () == m_progress_timer) {
+        bool updated = false;
+        if (m_position_pending) {
+            m_position_pending = false;
+            if (m_view && !m_bPosSliderPressed)
+                Q_EMIT positioned (m_pending_position, m_pending_length);
+            updated = true;
+        }
+        if (m_pending_loaded > -1) {
+            setLoaded (m_pending_loaded);
+            updated = true;
+        }
+        if (updated)
+            return; // keep throttling while updates come in
+        m_progress_timer = 0;
     }
     killTimer (e->timerId ());
 }
@@ -547,25 +581,53 @@ void PartBase::playingStopped () {
         m_view->reset ();
     }
     m_bPosSliderPressed = false;
+    m_position_pending = false;
+    m_pending_loaded = -1;
 }
 
 void PartBase::slotPlayingStopped () {
     playingStarted ();
 }
 
+/*
+ * Backends report progress many times a second. The first update is passed
+ * on right away, the ones following within the interval of the configured
+ * updates per second only keep the latest value, which is passed on when
+ * the interval ends.
+ */
+int PartBase::progressUpdateInterval () const {
+    return 1000 / qBound (1, m_settings->progressupdates, 1000);
+}
+
 void PartBase::setPosition (int position, int length) {
     if (m_view && !m_bPosSliderPressed) {
         if (m_media_manager->processes ().size () > 1)
-            Q_EMIT positioned (0, 0);
-        else
+            position = length = 0;
+        m_pending_position = position;
+        m_pending_length = length;
+        if (m_progress_timer) {
+            m_position_pending = true;
+        } else {
             Q_EMIT positioned (position, length);
+            m_progress_timer = startTimer (progressUpdateInterval ());
+        }
     }
 }
 
 void PartBase::setLoaded (int percentage) {
+    m_pending_loaded = -1;
     Q_EMIT loading (percentage);
 }
 
+void PartBase::updateLoaded (int percentage) {
+    if (m_progress_timer) {
+        m_pending_loaded = percentage;
+    } else {
+        setLoaded (percentage);
+        m_progress_timer = startTimer (progressUpdateInterval ());
+    }
+}
+
 qlonglong PartBase::position () const {
     return m_source ? 100 * m_source->position () : 0;
 }
@@ -822,6 +884,7 @@ void PartBase::stop () {
     const MediaManager::ProcessList::const_iterator e = processes.constEnd();
     for (MediaManager::ProcessList::const_iterator i = processes.constBegin(); i != e; ++i)
         (*i)->quit ();
+    prestartBackend (); // quitProcesses stopped it
     if (m_view) {
         m_view->setCursor (QCursor (Qt::ArrowCursor));
         if (b->isChecked ())
@@ -1083,13 +1146,52 @@ void Source::setLength (NodePtr, int len) {
     m_player->setPosition (m_position, m_length);
 }
 
+/* time before the end of an item to start preparing the next, deci-seconds */
+static const int preroll_time = 50;
+
 void Source::setPosition (int pos) {
     m_position = pos;
     m_player->setPosition (pos, m_length);
+    if (m_length > 0 && m_length - pos < preroll_time)
+        prerollNext ();
+}
+
+void Source::prerollNext () {
+    Mrl *cur = current ();
+    if (!cur || Mrl::SingleMode != cur->view_mode || !cur->media_info ||
+            MediaManager::AudioVideo != cur->media_info->type)
+        return;
+    Node *next = cur;
+    while (next && next != m_document.ptr ()) {
+        if (next->nextSibling ()) {
+            next = next->nextSibling ();
+            while (!next->isPlayable () && next->firstChild ())
+                next = next->firstChild ();
+            if (next->isPlayable ()) {
+                Mrl *mrl = next->mrl ();
+                if (mrl && Mrl::SingleMode == mrl->view_mode &&
+                        m_prerolled.ptr () != mrl) {
+                    releasePreroll ();
+                    mrl->preroll ();
+                    m_prerolled = mrl;
+                }
+                break;
+            }
+        } else {
+            next = next->parentNode ();
+        }
+    }
+}
+
+void Source::releasePreroll (Mrl *keep) {
+    Node *n = m_prerolled.ptr ();
+    m_prerolled = nullptr;
+    if (n && n != keep && n->mrl ())
+        n->mrl ()->releasePreroll ();
 }
 
 void Source::setLoading (int percentage) {
-    m_player->setLoaded (percentage);
+    m_player->updateLoaded (percentage);
 }
 
 /*
@@ -1157,6 +1259,7 @@ void Source::reset () {
         m_document = nullptr;
         doc->reset ();
         m_document = doc;
+        releasePreroll ();
         m_player->updateTree ();
     }
     init ();
@@ -1219,10 +1322,13 @@ void Source::stateElementChanged (Node *elm, Node::State os, Node::State ns) {
                  !elm->parentNode ()->mrl () ||
                  Mrl::WindowMode != elm->parentNode ()->mrl ()->view_mode))
             setCurrent (elm->mrl ());
-        if (m_current.ptr () == elm)
+        if (m_current.ptr () == elm) {
+            releasePreroll (elm->mrl ());
             Q_EMIT startPlaying ();
+        }
     } else if (ns == Node::state_deactivated) {
         if (elm == m_document) {
+            releasePreroll ();
             NodePtrW guard = elm;
             Q_EMIT endOfPlayItems (); // played all items FIXME on jumps
             if (!guard)
@@ -113,6 +113,10 @@ public:
     void setLength (NodePtr, int len);
     /* setPosition (pos) set position in deci-seconds */
     void setPosition (int pos) KMPLAYERCOMMON_NO_EXPORT;
+    /* get the item following the current one ready to play */
+    void prerollNext () KMPLAYERCOMMON_NO_EXPORT;
+    /* undo prerollNext, unless keep is the prerolled item */
+    void releasePreroll (Mrl *keep=nullptr) KMPLAYERCOMMON_NO_EXPORT;
     virtual void setIdentified (bool b = true);
     KMPLAYERCOMMON_NO_EXPORT void setAutoPlay (bool b) { m_auto_play = b; }
     KMPLAYERCOMMON_NO_EXPORT bool autoPlay () const { return m_auto_play; }
@@ -156,6 +160,7 @@ protected:
 
     NodePtr m_document;
     NodePtrW m_current;
+    NodePtrW m_prerolled;
     const char* m_name;
     PartBase * m_player;
     QString m_recordcmd;
@@ -300,6 +305,12 @@ public Q_SLOTS:
     void decreaseVolume ();
     void setPosition (int position, int length) KMPLAYERCOMMON_NO_EXPORT;
     virtual void setLoaded (int percentage);
+    /* like setLoaded, but throttled together with setPosition */
+    void updateLoaded (int percentage) KMPLAYERCOMMON_NO_EXPORT;
+    /* ms between position/loaded updates, from Settings::progressupdates */
+    int progressUpdateInterval () const KMPLAYERCOMMON_NO_EXPORT;
+    /* start the url source backend ahead of playing, if configured */
+    void prestartBackend () KMPLAYERCOMMON_NO_EXPORT;
     virtual void processCreated (Process *);
 public:
     bool isSeekable (void) const override;
@@ -367,12 +378,17 @@ protected:
     KBookmarkMenu * m_bookmark_menu;
     int m_update_tree_timer;
     int m_rec_timer;
+    int m_progress_timer;
+    int m_pending_position;
+    int m_pending_length;
+    int m_pending_loaded;
     bool m_noresize : 1;
     bool m_auto_controls : 1;
     bool m_use_agent : 1;
     bool m_bPosSliderPressed : 1;
     bool m_in_update_tree : 1;
     bool m_update_tree_full : 1;
+    bool m_position_pending : 1;
 };
 
 } // namespace
@@ -8,6 +8,7 @@
 #include <ctime>
 
 #include <QTextStream>
+#include <QSet>
 #ifdef KMPLAYER_WITH_EXPAT
 #include <expat.h>
 #endif
@@ -158,11 +159,12 @@ void ConnectionList::clear () {
 
 //-----------------------------------------------------------------------------
 
-TimerPosting::TimerPosting (int ms, unsigned eid)
+TimerPosting::TimerPosting (int ms, unsigned eid, bool aligned)
  : Posting (nullptr, MsgEventTimer),
    event_id (eid),
    milli_sec (ms),
-   interval (false) {}
+   interval (false),
+   frame_aligned (aligned) {}
 
 //-----------------------------------------------------------------------------
 
@@ -349,8 +351,15 @@ void Node::clear () {
 }
 
 void Node::clearChildren () {
-    if (m_doc)
-        document()->m_tree_version++;
+    if (m_doc) {
+        Document *doc = document ();
+        doc->m_tree_version++;
+        if (doc == this)
+            doc->invalidateIndex (); // all gone
+        else
+            for (Node *c = m_first_child.ptr (); c; c = c->nextSibling ())
+                doc->indexRemoved (c);
+    }
     while (m_first_child != m_last_child) {
         // avoid stack abuse with 10k children derefing each other
         m_last_child->m_parent = nullptr;
@@ -364,26 +373,34 @@ void Node::clearChildren () {
 
 template <>
 void TreeNode<Node>::appendChild (Node *c) {
-    static_cast <Node *> (this)->document()->m_tree_version++;
+    Document *doc = static_cast <Node *> (this)->document();
+    doc->m_tree_version++;
     Q_ASSERT (!c->parentNode ());
     appendChildImpl (c);
+    doc->indexInserted (c);
 }
 
 template <>
 void TreeNode<Node>::insertBefore (Node *c, Node *b) {
     Q_ASSERT (!c->parentNode ());
-    static_cast <Node *> (this)->document()->m_tree_version++;
+    Document *doc = static_cast <Node *> (this)->document();
+    doc->m_tree_version++;
     insertBeforeImpl (c, b);
+    doc->indexInserted (c);
 }
 
 template <>
 void TreeNode<Node>::removeChild (NodePtr c) {
-    static_cast <Node *> (this)->document()->m_tree_version++;
+    Document *doc = static_cast <Node *> (this)->document();
+    doc->m_tree_version++;
+    doc->indexRemoved (c);
     removeChildImpl (c);
 }
 
 void Node::replaceChild (NodePtr _new, NodePtr old) {
-    document()->m_tree_version++;
+    Document *doc = document ();
+    doc->m_tree_version++;
+    doc->indexRemoved (old);
     if (old->m_prev) {
         old->m_prev->m_next = _new;
         _new->m_prev = old->m_prev;
@@ -402,6 +419,7 @@ void Node::replaceChild (NodePtr _new, NodePtr old) {
     }
     _new->m_parent = this;
     old->m_parent = nullptr;
+    doc->indexInserted (_new);
 }
 
 Node *Node::childFromTag (const QString &) {
@@ -645,6 +663,8 @@ void Element::resetParam (const TrieString &name, int mid) {
 }
 
 void Element::setAttribute (const TrieString & name, const QString & value) {
+    if (m_doc && name == Ids::attr_id && parentNode ())
+        document ()->invalidateIndex ();
     for (Attribute *a = m_attributes.first (); a; a = a->nextSibling ())
         if (name == a->name ()) {
             if (value.isNull ())
@@ -690,6 +710,8 @@ void Element::clear () {
 }
 
 void Element::setAttributes (const AttributeList &attrs) {
+    if (m_doc && parentNode ()) // not when parsing, added to the tree after
+        document ()->invalidateIndex ();
     m_attributes = attrs;
 }
 
@@ -828,7 +850,10 @@ void *Mrl::role (RoleType msg, void *content) {
 void Mrl::activate () {
     if (!resolved && isPlayable ()) {
         setState (state_deferred);
-        media_info = new MediaInfo (this, MediaManager::AudioVideo);
+        if (!media_info) // else still resolving from preroll ()
+            media_info = new MediaInfo (this, MediaManager::AudioVideo);
+        else if (media_info->downloading ())
+            return;
         resolved = media_info->wget (absolutePath ());
         if (resolved && isPlayable ()) {
             // ignore the MsgMediaReady message redirection
@@ -859,6 +884,26 @@ void Mrl::begin () {
     }
 }
 
+void Mrl::preroll () {
+    if (media_info || src.isEmpty () || state != state_init)
+        return;
+    media_info = new MediaInfo (this, MediaManager::AudioVideo);
+    if (!resolved)
+        resolved = media_info->wget (absolutePath ());
+    if (resolved)
+        media_info->create ();
+    if (media_info->media &&
+            MediaManager::AudioVideo == media_info->media->type ())
+        static_cast <AudioVideoMedia *> (media_info->media)->preroll ();
+}
+
+void Mrl::releasePreroll () {
+    if (state_init == state && media_info) {
+        delete media_info;
+        media_info = nullptr;
+    }
+}
+
 void Mrl::defer () {
     if (media_info && media_info->media)
         media_info->media->pause ();
@@ -914,12 +959,112 @@ unsigned int Mrl::parseTimeString (const QString &ts) {
 
 //----------------------%<-----------------------------------------------------
 
-EventData::EventData (Node *t, Posting *e, EventData *n)
- : target (t), event (e), next (n) {}
+static bool postponedSensible (MessageType msg) {
+    return msg == MsgEventTimer ||
+        msg == MsgEventStarted ||
+        msg == MsgEventStopped;
+}
+
+EventData::EventData (Node *t, Posting *e)
+ : target (t), event (e), sequence (0), queue_index (-1),
+   postponed_sensible (postponedSensible (e->message)), paused (false) {}
 
 EventData::~EventData () {
     delete event;
 }
+
+//-----------------------------------------------------------------------------
+
+static inline bool eventBefore (const EventData *a, const EventData *b) {
+    if (a->postponed_sensible != b->postponed_sensible)
+        return b->postponed_sensible;
+    if (a->timeout.tv_sec != b->timeout.tv_sec)
+        return a->timeout.tv_sec < b->timeout.tv_sec;
+    if (a->timeout.tv_usec != b->timeout.tv_usec)
+        return a->timeout.tv_usec < b->timeout.tv_usec;
+    return (int) (a->sequence - b->sequence) < 0;
+}
+
+void EventQueue::place (int i, EventData *ed) {
+    heap[i] = ed;
+    ed->queue_index = i;
+}
+
+void EventQueue::siftUp (int i) {
+    EventData *ed = heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!eventBefore (ed, heap[parent]))
+            break;
+        place (i, heap[parent]);
+        i = parent;
+    }
+    place (i, ed);
+}
+
+void EventQueue::siftDown (int i) {
+    EventData *ed = heap[i];
+    const int n = heap.size ();
+    while (true) {
+        int child = 2 * i + 1;
+        if (child >= n)
+            break;
+        if (child + 1 < n && eventBefore (heap[child + 1], heap[child]))
+            ++child;
+        if (!eventBefore (heap[child], ed))
+            break;
+        place (i, heap[child]);
+        i = child;
+    }
+    place (i, ed);
+}
+
+void EventQueue::insert (EventData *ed) {
+    heap.append (ed);
+    siftUp (heap.size () - 1);
+}
+
+void EventQueue::remove (EventData *ed) {
+    int i = ed->queue_index;
+    EventData *last = heap.takeLast ();
+    ed->queue_index = -1;
+    if (last != ed) {
+        place (i, last);
+        siftUp (i);
+        siftDown (last->queue_index);
+    }
+}
+
+void EventQueue::clear () {
+    heap.clear ();
+}
+//-----------------------------------------------------------------------------
+
+static const int lateness_limits [TimerStatistics::LatenessBuckets] = {
+    1, 2, 5, 10, 20, 50, 100, 0x7FFFFFFF
+};
+
+TimerStatistics::TimerStatistics () {
+    reset ();
+}
+
+void TimerStatistics::reset () {
+    wakeups = events = max_events = 0;
+    for (int i = 0; i < LatenessBuckets; ++i)
+        lateness[i] = 0;
+}
+
+void TimerStatistics::addLateness (int ms) {
+    int i = 0;
+    while (i < LatenessBuckets - 1 && ms >= lateness_limits[i])
+        ++i;
+    lateness[i]++;
+}
+
+int TimerStatistics::latenessBucketLimit (int bucket) {
+    return lateness_limits[bucket];
+}
+
 //-----------------------------------------------------------------------------
 
 Postpone::Postpone (NodePtr doc) : m_doc (doc) {
@@ -940,16 +1085,169 @@ Document::Document (const QString & s, PlayListNotify * n)
  : Mrl (dummy_element, id_node_document),
    notify_listener (n),
    m_tree_version (0),
-   event_queue (nullptr),
-   paused_queue (nullptr),
    cur_event (nullptr),
-   cur_timeout (-1) {
+   event_sequence (0),
+   dispatch_slack (5),
+   frame_interval (25),
+   cur_timeout (-1),
+   index (nullptr),
+   virtual_clock (false) {
     m_doc = m_self; // just-in-time setting fragile m_self to m_doc
     src = s;
 }
 
 Document::~Document () {
     qCDebug(LOG_KMPLAYER_COMMON) << "~Document " << src;
+    delete index;
+}
+
+namespace KMPlayer {
+
+struct NameIndex {
+    NameIndex () : ordered (true) {}
+
+    QVector <Node *> nodes;
+    QHash <Node *, int> positions; // of the nodes in the vector
+    bool ordered;                  // nodes are in document order
+};
+
+struct DocumentIndex {
+    void add (Node *n, bool in_order);
+    void remove (Node *n);
+    const QVector <Node *> &nodes (Document *doc, const TrieString &name);
+
+    QHash <QString, Node *> ids;
+    QSet <QString> duplicate_ids;
+    QHash <TrieString, NameIndex> names;
+};
+
+}
+
+static bool isTextNode (Node *n) {
+    return n->id == id_node_text || n->id == id_node_cdata;
+}
+
+/*
+ * Nodes added at the end of the document keep the names in document
+ * order, others are sorted on lookup
+ */
+void DocumentIndex::add (Node *n, bool in_order) {
+    if (isTextNode (n))
+        return; // no name lookups for text
+    NameIndex &ni = names[TrieString (n->nodeName ())];
+    ni.positions.insert (n, ni.nodes.size ());
+    ni.nodes.append (n);
+    if (!in_order)
+        ni.ordered = false;
+    if (n->isElementNode ()) {
+        QString id = static_cast <Element *> (n)->getAttribute (Ids::attr_id);
+        if (!id.isEmpty ()) {
+            if (ids.contains (id))
+                duplicate_ids.insert (id);
+            else
+                ids.insert (id, n);
+        }
+    }
+    for (Node *c = n->firstChild (); c; c = c->nextSibling ())
+        add (c, in_order);
+}
+
+/*
+ * A removed id stays in duplicate_ids, getElementById then walks the tree
+ */
+void DocumentIndex::remove (Node *n) {
+    if (isTextNode (n))
+        return;
+    QHash <TrieString, NameIndex>::iterator it =
+        names.find (TrieString (n->nodeName ()));
+    if (it != names.end () && it->positions.contains (n)) {
+        // move the last one into the hole
+        int pos = it->positions.take (n);
+        Node *last = it->nodes.last ();
+        it->nodes.removeLast ();
+        if (last != n) {
+            it->nodes[pos] = last;
+            it->positions.insert (last, pos);
+            it->ordered = false;
+        }
+        if (it->nodes.isEmpty ())
+            names.erase (it);
+    }
+    if (n->isElementNode ()) {
+        QString id = static_cast <Element *> (n)->getAttribute (Ids::attr_id);
+        if (!id.isEmpty () && ids.value (id) == n)
+            ids.remove (id);
+    }
+    for (Node *c = n->firstChild (); c; c = c->nextSibling ())
+        remove (c);
+}
+
+const QVector <Node *> &DocumentIndex::nodes (Document *doc, const TrieString &name) {
+    static const QVector <Node *> empty;
+    QHash <TrieString, NameIndex>::iterator it = names.find (name);
+    if (it == names.end ())
+        return empty;
+    if (!it->ordered) {
+        it->nodes.clear ();
+        it->positions.clear ();
+        for (Node *n = doc->firstChild (); n; ) {
+            if (name == n->nodeName ()) {
+                it->positions.insert (n, it->nodes.size ());
+                it->nodes.append (n);
+            }
+            if (n->firstChild ()) {
+                n = n->firstChild ();
+                continue;
+            }
+            while (n && !n->nextSibling ())
+                n = n->parentNode ();
+            if (n)
+                n = n->nextSibling ();
+        }
+        it->ordered = true;
+    }
+    return it->nodes;
+}
+
+static bool inDocument (Node *n, Document *doc) {
+    while (n->parentNode ())
+        n = n->parentNode ();
+    return n == doc;
+}
+
+void Document::updateIndex () {
+    if (index)
+        return;
+    index = new DocumentIndex;
+    for (Node *c = firstChild (); c; c = c->nextSibling ())
+        index->add (c, true);
+}
+
+void Document::invalidateIndex () {
+    delete index;
+    index = nullptr;
+}
+
+void Document::indexInserted (Node *n) {
+    if (!index)
+        return;
+    bool last = true; // in document order, as when parsing
+    Node *p = n;
+    for (; p && p != this; p = p->parentNode ())
+        if (p->nextSibling ())
+            last = false;
+    if (p)
+        index->add (n, last);
+}
+
+void Document::indexRemoved (Node *n) {
+    if (index && inDocument (n, this))
+        index->remove (n);
+}
+
+QVector <Node *> Document::nodesByName (const TrieString &tag) {
+    updateIndex ();
+    return index->nodes (this, tag);
 }
 
 static Node *getElementByIdImpl (Node *n, const QString & id, bool inter) {
@@ -969,11 +1267,31 @@ static Node *getElementByIdImpl (Node *n, const QString & id, bool inter) {
 }
 
 Node *Document::getElementById (const QString & id) {
-    return getElementByIdImpl (this, id, true);
+    return getElementById (this, id, true);
 }
 
 Node *Document::getElementById (Node *n, const QString & id, bool inter) {
-    return getElementByIdImpl (n, id, inter);
+    if (!n->isElementNode ())
+        return nullptr;
+    if (static_cast <Element *> (n)->getAttribute (Ids::attr_id) == id)
+        return n;
+    if (!inDocument (n, this))
+        return getElementByIdImpl (n, id, inter);
+    updateIndex ();
+    if (index->duplicate_ids.contains (id))
+        return getElementByIdImpl (n, id, inter);
+    Node *elm = index->ids.value (id);
+    if (!elm)
+        return nullptr;
+    // check that getElementByIdImpl would find it starting at n
+    for (Node *c = elm; c != n; c = c->parentNode ()) {
+        Node *p = c->parentNode ();
+        if (!p || !p->isElementNode ())
+            return nullptr;
+        if (!inter && c->mrl () && c->mrl ()->opener.ptr () == p)
+            return nullptr;
+    }
+    return elm;
 }
 
 Node *Document::childFromTag (const QString & tag) {
@@ -991,6 +1309,7 @@ void Document::dispose () {
 void Document::activate () {
     first_event_time.tv_sec = 0;
     last_event_time = 0;
+    timer_stats.reset ();
     Mrl::activate ();
 }
 
@@ -1007,14 +1326,28 @@ void Document::undefer () {
 
 void Document::reset () {
     Mrl::reset ();
-    if (event_queue) {
+    if (timer_stats.wakeups) {
+        QString late;
+        for (int i = 0; i < TimerStatistics::LatenessBuckets; ++i) {
+            if (i < TimerStatistics::LatenessBuckets - 1)
+                late += QString ("<%1ms:%2 ").arg (lateness_limits[i]).arg (timer_stats.lateness[i]);
+            else
+                late += QString (">=%1ms:%2").arg (lateness_limits[i-1]).arg (timer_stats.lateness[i]);
+        }
+        qCDebug(LOG_KMPLAYER_COMMON) << "timer wakeups:" << timer_stats.wakeups
+            << "events:" << timer_stats.events
+            << "max/wakeup:" << timer_stats.max_events
+            << "lateness:" << late;
+    }
+    if (!event_queue.isEmpty ()) {
         if (notify_listener)
             notify_listener->setTimeout (-1);
-        while (event_queue) {
-            EventData *ed = event_queue;
-            event_queue = ed->next;
+        for (int i = 0; i < event_queue.count (); ++i) {
+            EventData *ed = event_queue.at (i);
+            postings.remove (ed->event);
             delete ed;
         }
+        event_queue.clear ();
         cur_timeout = -1;
     }
     postpone_lock = nullptr;
@@ -1055,8 +1388,38 @@ UpdateEvent::UpdateEvent (Document *doc, unsigned int skip)
     }
 }*/
 
+void Document::setVirtualClock (bool enable) {
+    if (enable == virtual_clock)
+        return;
+    if (enable)
+        gettimeofday (&virtual_time, nullptr);
+    virtual_clock = enable;
+    if (notify_listener && !cur_event) { // (re)start or stop the real timer
+        struct timeval now;
+        timeOfDay (now);
+        setNextTimeout (now);
+    }
+}
+
+void Document::advanceClock (int ms) {
+    if (!virtual_clock)
+        return;
+    addTime (virtual_time, ms);
+    // timer () handles the first event even when not due yet
+    for (int i = 0; i < 1000 && !cur_event && active (); ++i) {
+        EventData *first = event_queue.first ();
+        if (!first || (postpone_ref && first->postponed_sensible) ||
+                diffTime (first->timeout, virtual_time) > 0)
+            break;
+        timer ();
+    }
+}
+
 void Document::timeOfDay (struct timeval & tv) {
-    gettimeofday (&tv, nullptr);
+    if (virtual_clock)
+        tv = virtual_time;
+    else
+        gettimeofday (&tv, nullptr);
     if (!first_event_time.tv_sec) {
         first_event_time = tv;
         last_event_time = 0;
@@ -1065,40 +1428,66 @@ void Document::timeOfDay (struct timeval & tv) {
     }
 }
 
-static bool postponedSensible (MessageType msg) {
-    return msg == MsgEventTimer ||
-        msg == MsgEventStarted ||
-        msg == MsgEventStopped;
-}
-
+/*
+ * Non postponed sensible events go first, then ordered by timeout. Equal
+ * timeouts are handled in order of posting.
+ */
 void Document::insertPosting (Node *n, Posting *e, const struct timeval &tv) {
     if (!notify_listener)
         return;
-    bool postponed_sensible = postponedSensible (e->message);
-    EventData *prev = nullptr;
-    EventData *ed = event_queue;
-    for (; ed; ed = ed->next) {
-        int diff = diffTime (ed->timeout, tv);
-        bool psens = postponedSensible (ed->event->message);
-        if ((diff > 0 && postponed_sensible == psens) || (!postponed_sensible && psens))
-            break;
-        prev = ed;
-    }
-    ed = new EventData (n, e, ed);
+    EventData *ed = new EventData (n, e);
     ed->timeout = tv;
-    if (prev)
-        prev->next = ed;
-    else
-        event_queue = ed;
+    ed->due = tv;
+    if (frame_interval > 0 && first_event_time.tv_sec &&
+            MsgEventTimer == e->message &&
+            static_cast <TimerPosting *> (e)->frame_aligned) {
+        // share wakeups with other animation timers on the same frame, only
+        // the wakeup is rounded so reposts don't accumulate the error
+        int t = diffTime (tv, first_event_time);
+        if (t > 0) {
+            ed->timeout = first_event_time;
+            addTime (ed->timeout,
+                    (t + frame_interval - 1) / frame_interval * frame_interval);
+        }
+    }
+    ed->sequence = event_sequence++;
+    postings.insert (e, ed);
+    event_queue.insert (ed);
     //qCDebug(LOG_KMPLAYER_COMMON) << "setTimeout " << ms << " at:" << pos << " tv:" << tv.tv_sec << "." << tv.tv_usec;
 }
 
+EventData *Document::findPosting (const Posting *e) const {
+    return postings.value (e);
+}
+
+static void appendPaused (QVector <EventData *> &paused, EventData *ed) {
+    ed->paused = true;
+    ed->queue_index = paused.size ();
+    paused.append (ed);
+}
+
+void Document::removePosting (EventData *ed) {
+    postings.remove (ed->event);
+    if (ed->paused) {
+        EventData *last = paused_queue.takeLast ();
+        if (last != ed) {
+            last->queue_index = ed->queue_index;
+            paused_queue[ed->queue_index] = last;
+        }
+        ed->paused = false;
+        ed->queue_index = -1;
+    } else {
+        event_queue.remove (ed);
+    }
+}
+
 void Document::setNextTimeout (const struct timeval &now) {
     if (!cur_event) {              // if we're not processing events
         int timeout = 0x7FFFFFFF;
-        if (event_queue && active () &&
-                (!postpone_ref || !postponedSensible (event_queue->event->message)))
-            timeout = diffTime (event_queue->timeout, now);
+        EventData *first = event_queue.first ();
+        if (first && active () && !virtual_clock && // else advanceClock
+                (!postpone_ref || !first->postponed_sensible))
+            timeout = diffTime (first->timeout, now);
         timeout = 0x7FFFFFFF != timeout ? (timeout > 0 ? timeout : 0) : -1;
         if (timeout != cur_timeout) {
             cur_timeout = timeout;
@@ -1108,10 +1497,10 @@ void Document::setNextTimeout (const struct timeval &now) {
 }
 
 void Document::updateTimeout () {
-    if (!postpone_ref && event_queue && notify_listener) {
+    if (!postpone_ref && !event_queue.isEmpty () && notify_listener) {
         struct timeval now;
         if (cur_event)
-            now = cur_event->timeout;
+            now = cur_event->due;
         else
             timeOfDay (now);
         setNextTimeout (now);
@@ -1124,50 +1513,32 @@ Posting *Document::post (Node *n, Posting *e) {
         : 0;
     struct timeval now, tv;
     if (cur_event)
-        now = cur_event->timeout;
+        now = cur_event->due;
     else
         timeOfDay (now);
     tv = now;
     addTime (tv, ms);
     insertPosting (n, e, tv);
-    if (postpone_ref || event_queue->event == e)
+    EventData *first = event_queue.first ();
+    if (postpone_ref || (first && first->event == e))
         setNextTimeout (now);
     return e;
 }
 
-static EventData *findPosting (EventData *queue, EventData **prev, const Posting *e) {
-    *prev = nullptr;
-    for (EventData *ed = queue; ed; ed = ed->next) {
-        if (e == ed->event)
-            return ed;
-        *prev = ed;
-    }
-    return nullptr;
-}
-
 void Document::cancelPosting (Posting *e) {
     if (cur_event && cur_event->event == e) {
         delete cur_event->event;
         cur_event->event = nullptr;
     } else {
-        EventData *prev;
-        EventData **queue = &event_queue;
-        EventData *ed = findPosting (event_queue, &prev, e);
-        if (!ed) {
-            ed = findPosting (paused_queue, &prev, e);
-            queue = &paused_queue;
-        }
+        EventData *ed = findPosting (e);
         if (ed) {
-            if (prev) {
-                prev->next = ed->next;
-            } else {
-                *queue = ed->next;
-                if (!cur_event && queue == &event_queue) {
-                    struct timeval now;
-                    if (event_queue) // save a sys call
-                        timeOfDay (now);
-                    setNextTimeout (now);
-                }
+            bool was_first = ed == event_queue.first ();
+            removePosting (ed);
+            if (was_first && !cur_event) {
+                struct timeval now;
+                if (!event_queue.isEmpty ()) // save a sys call
+                    timeOfDay (now);
+                setNextTimeout (now);
             }
             delete ed;
         } else {
@@ -1178,19 +1549,17 @@ void Document::cancelPosting (Posting *e) {
 
 void Document::pausePosting (Posting *e) {
     if (cur_event && cur_event->event == e) {
-        paused_queue = new EventData (cur_event->target, cur_event->event, paused_queue);
-        paused_queue->timeout = cur_event->timeout;
+        EventData *ed = new EventData (cur_event->target, cur_event->event);
+        ed->timeout = cur_event->timeout;
+        ed->due = cur_event->due;
         cur_event->event = nullptr;
+        postings.insert (e, ed);
+        appendPaused (paused_queue, ed);
     } else {
-        EventData *prev;
-        EventData *ed = findPosting (event_queue, &prev, e);
-        if (ed) {
-            if (prev)
-                prev->next = ed->next;
-            else
-                event_queue = ed->next;
-            ed->next = paused_queue;
-            paused_queue = ed;
+        EventData *ed = findPosting (e);
+        if (ed && !ed->paused) {
+            event_queue.remove (ed);
+            appendPaused (paused_queue, ed);
         } else {
             qCCritical(LOG_KMPLAYER_COMMON) << "pauseEvent not found";
         }
@@ -1198,15 +1567,11 @@ void Document::pausePosting (Posting *e) {
 }
 
 void Document::unpausePosting (Posting *e, int ms) {
-    EventData *prev;
-    EventData *ed = findPosting (paused_queue, &prev, e);
-    if (ed) {
-        if (prev)
-            prev->next = ed->next;
-        else
-            paused_queue = ed->next;
-        addTime (ed->timeout, ms);
-        insertPosting (ed->target, ed->event, ed->timeout);
+    EventData *ed = findPosting (e);
+    if (ed && ed->paused) {
+        removePosting (ed);
+        addTime (ed->due, ms);
+        insertPosting (ed->target, ed->event, ed->due);
         ed->event = nullptr;
         delete ed;
     } else {
@@ -1214,20 +1579,43 @@ void Document::unpausePosting (Posting *e, int ms) {
     }
 }
 
+int Document::remainingTime (const Posting *e) {
+    EventData *ed = findPosting (e);
+    if (!ed || ed->paused)
+        return -1;
+    struct timeval now;
+    timeOfDay (now);
+    int ms = diffTime (ed->timeout, now);
+    return ms > 0 ? ms : 0;
+}
+
+void Document::setDispatchMode (int slack, int interval) {
+    dispatch_slack = slack > 0 ? slack : 0;
+    frame_interval = interval > 0 ? interval : 0;
+}
+
 void Document::timer () {
     struct timeval now;
-    cur_event = event_queue;
+    cur_event = event_queue.first ();
     if (cur_event) {
         NodePtrW guard = this;
-        struct timeval start = cur_event->timeout;
+        struct timeval deadline;
         timeOfDay (now);
-
-        // handle max 100 timeouts with timeout set to now
-        for (int i = 0; i < 100 && active (); ++i) {
-            if (postpone_ref && postponedSensible (cur_event->event->message))
+        deadline = now;
+        if (!virtual_clock)
+            addTime (deadline, dispatch_slack);
+        int count = 0;
+
+        // handle all timeouts due before deadline, the limit guards against
+        // handlers reposting without delay
+        while (count < 1000 && active ()) {
+            if (postpone_ref && cur_event->postponed_sensible)
                 break;
             // remove from queue
-            event_queue = cur_event->next;
+            removePosting (cur_event);
+            int late = diffTime (now, cur_event->timeout);
+            timer_stats.addLateness (late > 0 ? late : 0);
+            ++count;
 
             if (!cur_event->target) {
                 // some part of document has gone and didn't remove timer
@@ -1243,20 +1631,24 @@ void Document::timer () {
                     TimerPosting *te = static_cast <TimerPosting *> (cur_event->event);
                     if (te->interval) {
                         te->interval = false; // reset interval
-                        addTime (cur_event->timeout, te->milli_sec);
+                        addTime (cur_event->due, te->milli_sec);
                         insertPosting (cur_event->target,
                                 cur_event->event,
-                                cur_event->timeout);
+                                cur_event->due);
                         cur_event->event = nullptr;
                     }
                 }
             }
             delete cur_event;
-            cur_event = event_queue;
-            if (!cur_event || diffTime (cur_event->timeout, start) > 5)
+            cur_event = event_queue.first ();
+            if (!cur_event || diffTime (cur_event->timeout, deadline) > 0)
                 break;
         }
         cur_event = nullptr;
+        timer_stats.wakeups++;
+        timer_stats.events += count;
+        if (count > (int) timer_stats.max_events)
+            timer_stats.max_events = count;
     }
     setNextTimeout (now);
 }
@@ -1273,7 +1665,7 @@ PostponePtr Document::postpone () {
         notify_listener->enableRepaintUpdaters (false, 0);
     if (!cur_event) {
         struct timeval now;
-        if (event_queue) // save a sys call
+        if (!event_queue.isEmpty ()) // save a sys call
             timeOfDay (now);
         setNextTimeout (now);
     }
@@ -1286,10 +1678,16 @@ void Document::proceed (const struct timeval &postponed_time) {
     struct timeval now;
     timeOfDay (now);
     int diff = diffTime (now, postponed_time);
-    if (event_queue) {
-        for (EventData *ed = event_queue; ed; ed = ed->next)
-            if (ed->event && postponedSensible (ed->event->message))
+    if (!event_queue.isEmpty ()) {
+        // postponed sensible events all shift by the same amount and sort
+        // after the others, so the heap order stays valid
+        for (int i = 0; i < event_queue.count (); ++i) {
+            EventData *ed = event_queue.at (i);
+            if (ed->postponed_sensible) {
                 addTime (ed->timeout, diff);
+                addTime (ed->due, diff);
+            }
+        }
         setNextTimeout (now);
     }
     if (notify_listener)
@@ -1589,32 +1987,57 @@ static void cdataEnd (void *data) {
     builder->cdataEnd ();
 }
 
-void KMPlayer::readXML (NodePtr root, QTextStream & in, const QString & firstline, bool set_opener) {
-    bool ok = true;
-    DocumentBuilder builder (root, set_opener);
-    XML_Parser parser = XML_ParserCreate (0L);
+namespace KMPlayer {
+
+class XMLReaderPrivate
+{
+public:
+    XMLReaderPrivate (NodePtr r, bool set_opener);
+    ~XMLReaderPrivate ();
+    void parse (const QByteArray &ba, bool final);
+
+    DocumentBuilder builder;
+    XML_Parser parser;
+    NodePtr root;
+    bool ok;
+};
+
+} // namespace KMPlayer
+
+XMLReaderPrivate::XMLReaderPrivate (NodePtr r, bool set_opener)
+ : builder (r, set_opener), parser (XML_ParserCreate (0L)), root (r), ok (true) {
     XML_SetUserData (parser, &builder);
     XML_SetElementHandler (parser, startTag, endTag);
     XML_SetCharacterDataHandler (parser, characterData);
     XML_SetCdataSectionHandler (parser, cdataStart, cdataEnd);
-    if (!firstline.isEmpty ()) {
-        QString str (firstline + QChar ('\n'));
-        QByteArray ba = str.toUtf8();
-        char *buf = ba.data();
-        ok = XML_Parse(parser, buf, strlen (buf), false) != XML_STATUS_ERROR;
-        if (!ok)
-            qCWarning(LOG_KMPLAYER_COMMON) << XML_ErrorString(XML_GetErrorCode(parser)) << " at " << XML_GetCurrentLineNumber(parser) << " col " << XML_GetCurrentColumnNumber(parser);
-    }
-    if (ok && !in.atEnd ()) {
-        QByteArray ba = in.readAll().toUtf8();
-        char *buf = ba.data();
-        ok = XML_Parse(parser, buf, strlen (buf), true) != XML_STATUS_ERROR;
-        if (!ok)
-            qCWarning(LOG_KMPLAYER_COMMON) << XML_ErrorString(XML_GetErrorCode(parser)) << " at " << XML_GetCurrentLineNumber(parser) << " col " << XML_GetCurrentColumnNumber(parser);
-    }
-    XML_ParserFree(parser);
-    root->normalize ();
-    //return ok;
+}
+
+XMLReaderPrivate::~XMLReaderPrivate () {
+    XML_ParserFree (parser);
+}
+
+void XMLReaderPrivate::parse (const QByteArray &ba, bool final) {
+    if (!ok)
+        return;
+    ok = XML_Parse (parser, ba.constData (), ba.size (), final) != XML_STATUS_ERROR;
+    if (!ok)
+        qCWarning(LOG_KMPLAYER_COMMON) << XML_ErrorString(XML_GetErrorCode(parser)) << " at " << XML_GetCurrentLineNumber(parser) << " col " << XML_GetCurrentColumnNumber(parser);
+}
+
+XMLReader::XMLReader (NodePtr root, bool set_opener)
+ : d (new XMLReaderPrivate (root, set_opener)) {}
+
+XMLReader::~XMLReader () {
+    delete d;
+}
+
+void XMLReader::feed (const QString &data) {
+    d->parse (data.toUtf8 (), false);
+}
+
+void XMLReader::finish () {
+    d->parse (QByteArray (), true);
+    d->root->normalize ();
 }
 
 //-----------------------------------------------------------------------------
@@ -1629,22 +2052,58 @@ class SimpleSAXParser
         tok_slash, tok_exclamation, tok_amp, tok_hash, tok_colon,
         tok_semi_colon, tok_question_mark, tok_cdata_start };
 public:
+    /*
+     * A token is a view in the parse buffer, unless replaced by a text,
+     * eg. for entities. Strings are only created when really needed.
+     */
     struct TokenInfo {
-        TokenInfo () : token (tok_empty) {}
+        TokenInfo () : token (tok_empty), buffer (nullptr), position (0), length (0), has_text (false) {}
         void *operator new (size_t);
         void operator delete (void *);
+        QStringRef string () const {
+            if (has_text)
+                return QStringRef (&text);
+            return length ? QStringRef (buffer, position, length) : QStringRef ();
+        }
+        bool isEmpty () const { return has_text ? text.isEmpty () : !length; }
+        void append (const QString *buf, int pos) { // chars are consecutive
+            if (!length) {
+                buffer = buf;
+                position = pos;
+            }
+            ++length;
+        }
+        void setText (const QString &s) {
+            text = s;
+            has_text = true;
+        }
+        void clear () {
+            length = 0;
+            text.truncate (0);
+            has_text = false;
+        }
         Token token;
-        QString string;
+        const QString *buffer;
+        int position;
+        int length;
+        QString text;
+        bool has_text;
         SharedPtr <TokenInfo> next;
     };
     typedef SharedPtr <TokenInfo> TokenInfoPtr;
-    SimpleSAXParser (DocumentBuilder & b) : builder (b), position (0), equal_seen (false), in_dbl_quote (false), in_sngl_quote (false), have_error (false), no_entitity_look_ahead (false), have_next_char (false) {}
+    SimpleSAXParser (DocumentBuilder & b) : builder (b), position (0), char_position (0), equal_seen (false), in_dbl_quote (false), in_sngl_quote (false), have_error (false), no_entitity_look_ahead (false), have_next_char (false) {}
     virtual ~SimpleSAXParser () {};
-    bool parse (QTextStream & d);
+    bool parse (const QStringRef &d);
 private:
-    QTextStream * data;
+    bool atEnd () const { return position >= buffer.size (); }
+    void readChar () {
+        char_position = position++;
+        next_char = buffer[char_position];
+    }
+    QString buffer;
     DocumentBuilder & builder;
     int position;
+    int char_position;
     QChar next_char;
     enum State {
         InTag, InStartTag, InPITag, InDTDTag, InEndTag, InAttributes, InContent, InCDATA, InComment
@@ -1679,6 +2138,7 @@ private:
     bool nextToken ();
     void push ();
     void push_attribute ();
+    void trim ();
 };
 
 } // namespace
@@ -1693,17 +2153,57 @@ inline void SimpleSAXParser::TokenInfo::operator delete (void *p) {
     token_pool.dealloc (p);
 }
 
-void KMPlayer::readXML (NodePtr root, QTextStream & in, const QString & firstline, bool set_opener) {
-    DocumentBuilder builder (root, set_opener);
+namespace KMPlayer {
+
+class XMLReaderPrivate
+{
+public:
+    XMLReaderPrivate (NodePtr r, bool set_opener)
+     : builder (r, set_opener), parser (builder), root (r) {}
+
+    DocumentBuilder builder;
+    SimpleSAXParser parser;
+    NodePtr root;
+    QString pending;
+};
+
+} // namespace KMPlayer
+
+XMLReader::XMLReader (NodePtr root, bool set_opener)
+ : d (new XMLReaderPrivate (root, set_opener)) {
     root->opened ();
-    SimpleSAXParser parser (builder);
-    if (!firstline.isEmpty ()) {
-        QString str (firstline + QChar ('\n'));
-        QTextStream fl_in (&str, QIODevice::ReadOnly);
-        parser.parse (fl_in);
+}
+
+XMLReader::~XMLReader () {
+    delete d;
+}
+
+void XMLReader::feed (const QString &data) {
+    // only parse up to a '>', that always ends a token
+    if (d->pending.isEmpty ()) {
+        int pos = data.lastIndexOf (QChar ('>'));
+        if (pos < 0) {
+            d->pending = data;
+        } else {
+            d->parser.parse (data.leftRef (pos + 1));
+            d->pending = data.mid (pos + 1);
+        }
+    } else {
+        d->pending += data;
+        int pos = d->pending.lastIndexOf (QChar ('>'));
+        if (pos > -1) {
+            d->parser.parse (d->pending.leftRef (pos + 1));
+            d->pending = d->pending.mid (pos + 1);
+        }
     }
-    if (!in.atEnd ())
-        parser.parse (in);
+}
+
+void XMLReader::finish () {
+    if (!d->pending.isEmpty ()) {
+        d->parser.parse (QStringRef (&d->pending));
+        d->pending.clear ();
+    }
+    NodePtr root = d->root;
     if (root->open) // endTag may have closed it
         root->closed ();
     for (NodePtr e = root->parentNode (); e; e = e->parentNode ()) {
@@ -1716,7 +2216,7 @@ void KMPlayer::readXML (NodePtr root, QTextStream & in, const QString & firstlin
 }
 
 void SimpleSAXParser::push () {
-    if (next_token->string.size ()) {
+    if (!next_token->isEmpty ()) {
         prev_token = token;
         token = next_token;
         if (prev_token)
@@ -1737,11 +2237,11 @@ void SimpleSAXParser::push_attribute () {
 
 bool SimpleSAXParser::nextToken () {
     TokenInfoPtr cur_token = token;
-    while (!data->atEnd () && cur_token == token && !(token && token->next)) {
+    while (!atEnd () && cur_token == token && !(token && token->next)) {
         if (have_next_char)
             have_next_char = false;
         else
-            *data >> next_char;
+            readChar ();
         bool append_char = true;
         if (next_char.isSpace ()) {
             if (next_token->token != tok_white_space)
@@ -1796,20 +2296,20 @@ bool SimpleSAXParser::nextToken () {
                 TokenInfoPtr prev_tmp = prev_token;
                 if (nextToken () && token->token == tok_text &&
                         nextToken () && token->token == tok_semi_colon) {
-                    if (prev_token->string == QString ("amp"))
-                        token->string = QChar ('&');
-                    else if (prev_token->string == QString ("lt"))
-                        token->string = QChar ('<');
-                    else if (prev_token->string == QString ("gt"))
-                        token->string = QChar ('>');
-                    else if (prev_token->string == QString ("quot"))
-                        token->string = QChar ('"');
-                    else if (prev_token->string == QString ("apos"))
-                        token->string = QChar ('\'');
-                    else if (prev_token->string == QString ("copy"))
-                        token->string = QChar (169);
+                    if (prev_token->string () == QLatin1String ("amp"))
+                        token->setText (QChar ('&'));
+                    else if (prev_token->string () == QLatin1String ("lt"))
+                        token->setText (QChar ('<'));
+                    else if (prev_token->string () == QLatin1String ("gt"))
+                        token->setText (QChar ('>'));
+                    else if (prev_token->string () == QLatin1String ("quot"))
+                        token->setText (QChar ('"'));
+                    else if (prev_token->string () == QLatin1String ("apos"))
+                        token->setText (QChar ('\''));
+                    else if (prev_token->string () == QLatin1String ("copy"))
+                        token->setText (QChar (169));
                     else
-                        token->string = QChar ('?');// TODO lookup more ..
+                        token->setText (QChar ('?'));// TODO lookup more ..
                     token->token = tok_text;
                     if (tmp) { // cut out the & xxx ; tokens
                         tmp->next = token;
@@ -1821,10 +2321,10 @@ bool SimpleSAXParser::nextToken () {
                         nextToken () && token->token == tok_semi_colon) {
                     //qCDebug(LOG_KMPLAYER_COMMON) << "char entity found " << prev_token->string << prev_token->string.toInt (0L, 16);
                     token->token = tok_text;
-                    if (!prev_token->string.startsWith (QChar ('x')))
-                        token->string = QChar (prev_token->string.toInt ());
+                    if (!prev_token->string ().startsWith (QChar ('x')))
+                        token->setText (QChar (prev_token->string ().toInt ()));
                     else
-                        token->string = QChar (prev_token->string.mid (1).toInt (nullptr, 16));
+                        token->setText (QChar (prev_token->string ().mid (1).toInt (nullptr, 16)));
                     if (tmp) { // cut out the '& # xxx ;' tokens
                         tmp->next = token;
                         token = tmp;
@@ -1833,7 +2333,7 @@ bool SimpleSAXParser::nextToken () {
                     token = tmp; // restore and insert the lost & token
                     tmp = TokenInfoPtr (new TokenInfo);
                     tmp->token = tok_amp;
-                    tmp->string += QChar ('&');
+                    tmp->setText (QChar ('&'));
                     tmp->next = token->next;
                     if (token)
                         token->next = tmp;
@@ -1851,9 +2351,9 @@ bool SimpleSAXParser::nextToken () {
             next_token->token = tok_text;
         }
         if (append_char)
-            next_token->string += next_char;
-        if (next_token->token == tok_text &&
-                next_char == QChar ('[' ) && next_token->string == "[CDATA[") {
+            next_token->append (&buffer, char_position);
+        if (next_token->token == tok_text && next_char == QChar ('[' ) &&
+                next_token->string () == QLatin1String ("[CDATA[")) {
             next_token->token = tok_cdata_start;
             break;
         }
@@ -1862,7 +2362,7 @@ bool SimpleSAXParser::nextToken () {
         if (token && token->next) {
             prev_token = token;
             token = token->next;
-        } else if (next_token->string.size ()) {
+        } else if (!next_token->isEmpty ()) {
             push (); // last token
         } else
             return false;
@@ -1878,12 +2378,12 @@ bool SimpleSAXParser::readAttributes () {
         //qCDebug(LOG_KMPLAYER_COMMON) << "readAttributes " << token->string.latin1();
         if ((in_dbl_quote && token->token != tok_double_quote) ||
                     (in_sngl_quote && token->token != tok_single_quote)) {
-            attr_value += token->string;
+            attr_value += token->string ();
         } else if (token->token == tok_equal) {
             if (attr_name.isEmpty ())
                 return false;
             if (equal_seen)
-                attr_value += token->string; // EQ=a=2c ???
+                attr_value += token->string (); // EQ=a=2c ???
             //qCDebug(LOG_KMPLAYER_COMMON) << "equal_seen";
             equal_seen = true;
         } else if (token->token == tok_white_space) {
@@ -1891,29 +2391,29 @@ bool SimpleSAXParser::readAttributes () {
                 push_attribute ();
         } else if (token->token == tok_single_quote) {
             if (!equal_seen)
-                attr_name += token->string; // D'OH=xxx ???
+                attr_name += token->string (); // D'OH=xxx ???
             else if (in_sngl_quote) { // found one
                 push_attribute ();
             } else if (attr_value.isEmpty ())
                 in_sngl_quote = true;
             else
-                attr_value += token->string;
+                attr_value += token->string ();
         } else if (token->token == tok_colon) {
             if (equal_seen) {
-                attr_value += token->string;
+                attr_value += token->string ();
             } else {
                 attr_namespace = attr_name;
                 attr_name.clear();
             }
         } else if (token->token == tok_double_quote) {
             if (!equal_seen)
-                attr_name += token->string; // hmm
+                attr_name += token->string (); // hmm
             else if (in_dbl_quote) { // found one
                 push_attribute ();
             } else if (attr_value.isEmpty ())
                 in_dbl_quote = true;
             else
-                attr_value += token->string;
+                attr_value += token->string ();
             //qCDebug(LOG_KMPLAYER_COMMON) << "in_dbl_quote:"<< in_dbl_quote;
         } else if (token->token == tok_slash) {
             TokenInfoPtr mark_token = token;
@@ -1927,18 +2427,18 @@ bool SimpleSAXParser::readAttributes () {
                 token = mark_token;
             //qCDebug(LOG_KMPLAYER_COMMON) << "not end mark:"<< equal_seen;
                 if (equal_seen)
-                    attr_value += token->string; // ABBR=w/o ???
+                    attr_value += token->string (); // ABBR=w/o ???
                 else
-                    attr_name += token->string;
+                    attr_name += token->string ();
             }
         } else if (token->token == tok_angle_close) {
             if (!attr_name.isEmpty ())
                 push_attribute ();
             break;
         } else if (equal_seen) {
-            attr_value += token->string;
+            attr_value += token->string ();
         } else {
-            attr_name += token->string;
+            attr_name += token->string ();
         }
     }
     m_state = m_state->next;
@@ -1962,7 +2462,7 @@ bool SimpleSAXParser::readAttributes () {
 bool SimpleSAXParser::readPI () {
     // TODO: <?xml .. encoding="ENC" .. ?>
     if (!nextToken ()) return false;
-    if (token->token == tok_text && !token->string.compare ("xml")) {
+    if (token->token == tok_text && !token->string ().compare (QLatin1String ("xml"))) {
         m_state = new StateInfo (InAttributes, m_state);
         return readAttributes ();
     } else {
@@ -1978,7 +2478,7 @@ bool SimpleSAXParser::readPI () {
 bool SimpleSAXParser::readDTD () {
     //TODO: <!ENTITY ..>
     if (!nextToken ()) return false;
-    if (token->token == tok_text && token->string.startsWith (QString ("--"))) {
+    if (token->token == tok_text && token->string ().startsWith (QString ("--"))) {
         m_state = new StateInfo (InComment, m_state->next); // note: pop DTD
         return readComment ();
     }
@@ -1986,11 +2486,11 @@ bool SimpleSAXParser::readDTD () {
     if (token->token == tok_cdata_start) {
         m_state = new StateInfo (InCDATA, m_state->next); // note: pop DTD
         if (token->next) {
-            cdata = token->next->string;
+            cdata = token->next->string ().toString ();
             token->next = nullptr;
         } else {
-            cdata = next_token->string;
-            next_token->string.truncate (0);
+            cdata = next_token->string ().toString ();
+            next_token->clear ();
             next_token->token = tok_empty;
         }
         return readCDATA ();
@@ -2004,8 +2504,8 @@ bool SimpleSAXParser::readDTD () {
 }
 
 bool SimpleSAXParser::readCDATA () {
-    while (!data->atEnd ()) {
-        *data >> next_char;
+    while (!atEnd ()) {
+        readChar ();
         if (next_char == QChar ('>') && cdata.endsWith (QString ("]]"))) {
             cdata.truncate (cdata.size () - 2);
             m_state = m_state->next;
@@ -2028,7 +2528,7 @@ bool SimpleSAXParser::readCDATA () {
 bool SimpleSAXParser::readComment () {
     while (nextToken ()) {
         if (token->token == tok_angle_close && prev_token)
-            if (prev_token->string.endsWith (QString ("--"))) {
+            if (prev_token->string ().endsWith (QString ("--"))) {
                 m_state = m_state->next;
                 return true;
             }
@@ -2040,7 +2540,7 @@ bool SimpleSAXParser::readEndTag () {
     if (!nextToken ()) return false;
     if (token->token == tok_white_space)
         if (!nextToken ()) return false;
-    tagname = token->string;
+    tagname = token->string ().toString ();
     if (!nextToken ()) return false;
     if (token->token == tok_white_space)
         if (!nextToken ()) return false;
@@ -2071,14 +2571,38 @@ bool SimpleSAXParser::readTag () {
     }
     if (token->token != tok_text)
         return false; // FIXME entities
-    tagname = token->string;
+    tagname = token->string ().toString ();
     //qCDebug(LOG_KMPLAYER_COMMON) << "readTag " << tagname.latin1();
     m_state = new StateInfo (InAttributes, m_state);
     return readAttributes ();
 }
 
-bool SimpleSAXParser::parse (QTextStream & d) {
-    data = &d;
+/*
+ * Drops the parsed part of the buffer, so streaming a document doesn't keep
+ * all of it. Tokens refer to the buffer by position, keep what they use.
+ */
+void SimpleSAXParser::trim () {
+    QVector <TokenInfo *> refs;
+    TokenInfo *chains[] = { prev_token.ptr (), token.ptr (), next_token.ptr () };
+    for (int i = 0; i < 3; ++i)
+        for (TokenInfo *t = chains[i]; t; t = t->next.ptr ())
+            if (t->length && !t->has_text && !refs.contains (t))
+                refs.append (t);
+    int keep = char_position;
+    for (int i = 0; i < refs.size (); ++i)
+        keep = qMin (keep, refs[i]->position);
+    if (keep <= 0)
+        return;
+    buffer.remove (0, keep);
+    position -= keep;
+    char_position -= keep;
+    for (int i = 0; i < refs.size (); ++i)
+        refs[i]->position -= keep;
+}
+
+bool SimpleSAXParser::parse (const QStringRef &d) {
+    trim ();
+    buffer += d;
     if (!next_token) {
         next_token = TokenInfoPtr (new TokenInfo);
         m_state = new StateInfo (InContent, m_state);
@@ -2121,7 +2645,7 @@ bool SimpleSAXParser::parse (QTextStream & d) {
                         in_character_data = false;
                         white_space.truncate (0);
                     } else if (token->token == tok_white_space) {
-                        white_space += token->string;
+                        white_space += token->string ();
                     } else {
                         if (!white_space.isEmpty ()) {
                             if (!in_character_data) {
@@ -2132,7 +2656,7 @@ bool SimpleSAXParser::parse (QTextStream & d) {
                             have_error = !builder.characterData (white_space);
                             white_space.truncate (0);
                         }
-                        have_error = !builder.characterData (token->string);
+                        have_error = !builder.characterData (token->string ().toString ());
                         in_character_data = true;
                     }
                 }
@@ -2144,3 +2668,12 @@ bool SimpleSAXParser::parse (QTextStream & d) {
 }
 
 #endif // KMPLAYER_WITH_EXPAT
+
+void KMPlayer::readXML (NodePtr root, QTextStream & in, const QString & firstline, bool set_opener) {
+    XMLReader reader (root, set_opener);
+    if (!firstline.isEmpty ())
+        reader.feed (firstline + QChar ('\n'));
+    if (!in.atEnd ())
+        reader.feed (in.readAll ());
+    reader.finish ();
+}
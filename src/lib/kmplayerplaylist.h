@@ -13,6 +13,8 @@
 #include <sys/time.h>
 
 #include <QString>
+#include <QVector>
+#include <QHash>
 
 #include "kmplayercommon_export.h"
 #include "kmplayertypes.h"
@@ -31,6 +33,7 @@ class TextNode;
 class Posting;
 class Mrl;
 class ElementPrivate;
+class XMLReaderPrivate;
 class Visitor;
 class MediaInfo;
 
@@ -642,6 +645,10 @@ public:
     void deactivate () override;
     void message (MessageType msg, void *content=nullptr) override;
     void *role (RoleType msg, void *content=nullptr) override;
+    /// Resolves and creates the media before activation, for gapless playing
+    void preroll ();
+    /// Drops the media of preroll () when this Mrl isn't played after all
+    void releasePreroll ();
 
     static unsigned int parseTimeString (const QString &s);
 
@@ -708,13 +715,14 @@ public:
 /**
  * Posting signaling a timer event
  */
-class TimerPosting : public Posting
+class KMPLAYERCOMMON_EXPORT TimerPosting : public Posting
 {
 public:
-    TimerPosting (int ms, unsigned eid=0);
+    TimerPosting (int ms, unsigned eid=0, bool aligned=false);
     unsigned event_id;
     int milli_sec;
     bool interval; // set to 'true' in 'Node::message()' to make it repeat
+    bool frame_aligned; // round timeout up to Document's frame clock
 };
 
 class UpdateEvent
@@ -754,16 +762,60 @@ typedef WeakPtr <Postpone> PostponePtrW;
 
 struct EventData
 {
-    EventData (Node *t, Posting *e, EventData *n);
+    EventData (Node *t, Posting *e);
     ~EventData ();
 
     NodePtrW target;
     Posting *event;
     struct timeval timeout;
+    struct timeval due;      // timeout before frame alignment, base for reposts
+    unsigned int sequence;   // insertion order, keeps equal timeouts FIFO
+    int queue_index;         // position in the heap or paused list, or -1
+    bool postponed_sensible; // postponed sensible events sort after others
+    bool paused;
+};
+
+/**
+ * Priority queue of EventData, a binary min-heap on
+ * (postponed sensible, timeout, sequence) order
+ */
+class EventQueue
+{
+public:
+    bool isEmpty () const { return heap.isEmpty (); }
+    int count () const { return heap.size (); }
+    EventData *first () const { return heap.isEmpty () ? nullptr : heap[0]; }
+    EventData *at (int i) const { return heap[i]; }
+    void insert (EventData *ed);
+    void remove (EventData *ed);
+    void clear ();
+private:
+    void siftUp (int i);
+    void siftDown (int i);
+    void place (int i, EventData *ed);
+    QVector <EventData *> heap;
+};
 
-    EventData *next;
+/**
+ * Counters for Document::timer() dispatching
+ */
+struct KMPLAYERCOMMON_EXPORT TimerStatistics
+{
+    enum { LatenessBuckets = 8 };
+
+    TimerStatistics ();
+    void reset ();
+    void addLateness (int ms);
+    static int latenessBucketLimit (int bucket);
+
+    unsigned int wakeups;
+    unsigned int events;
+    unsigned int max_events;  // most events dispatched in one wakeup
+    unsigned int lateness [LatenessBuckets]; // ms, see latenessBucketLimit
 };
 
+struct DocumentIndex;
+
 /**
  * The root of the DOM tree
  */
@@ -775,6 +827,18 @@ public:
     ~Document () override;
     Node *getElementById (const QString & id);
     Node *getElementById (Node *start, const QString & id, bool inter_doc);
+    /**
+     * All element nodes named tag in document order. Like getElementById,
+     * this uses an index that follows the tree changes, and is rebuilt on
+     * first use after id attribute changes.
+     */
+    QVector <Node *> nodesByName (const TrieString &tag);
+    /**
+     * Drop the id and name index, for id changes it doesn't follow
+     */
+    void invalidateIndex ();
+    void indexInserted (Node *n) KMPLAYERCOMMON_NO_EXPORT;
+    void indexRemoved (Node *n) KMPLAYERCOMMON_NO_EXPORT;
     /** All nodes have shared pointers to Document,
      * so explicitly dispose it (calls clear and set m_doc to 0L)
      * */
@@ -790,6 +854,11 @@ public:
     void cancelPosting (Posting *event);
     void pausePosting (Posting *e);
     void unpausePosting (Posting *e, int ms);
+    /**
+     * ms until a posted event is due, 0 when overdue, -1 when it isn't
+     * queued or paused
+     */
+    int remainingTime (const Posting *e);
 
     void timeOfDay (struct timeval &);
     PostponePtr postpone ();
@@ -799,6 +868,20 @@ public:
      */
     void timer ();
     void updateTimeout ();
+    /**
+     * Events due within slack ms from now are dispatched in one timer()
+     * call, frame aligned TimerPosting timeouts are rounded up to a
+     * multiple of frame_interval ms since the document start, 0 disables.
+     */
+    void setDispatchMode (int slack, int frame_interval);
+    /**
+     * Stop following the wall clock, time then only moves on with
+     * advanceClock, so that frames can be rendered at a fixed rate.
+     * advanceClock handles the events due at the new time, the listener's
+     * timer is not used meanwhile.
+     */
+    void setVirtualClock (bool enable);
+    void advanceClock (int ms);
     /**
      * Document has list of postponed receivers, eg. for running (gif)movies
      */
@@ -807,19 +890,31 @@ public:
     PlayListNotify *notify_listener;
     unsigned int m_tree_version;
     unsigned int last_event_time;
+    TimerStatistics timer_stats;
 private:
     void proceed (const struct timeval & postponed_time);
     void insertPosting (Node *n, Posting *e, const struct timeval &tv);
     void setNextTimeout (const struct timeval &now);
 
+    EventData *findPosting (const Posting *e) const;
+    void removePosting (EventData *ed);
+    void updateIndex ();
+
     PostponePtrW postpone_ref;
     PostponePtr postpone_lock;
     ConnectionList m_PostponedListeners;
-    EventData *event_queue;
-    EventData *paused_queue;
+    EventQueue event_queue;
+    QVector <EventData *> paused_queue;
+    QHash <const Posting *, EventData *> postings;
     EventData *cur_event;
+    unsigned int event_sequence;
+    int dispatch_slack;
+    int frame_interval;
     int cur_timeout;
     struct timeval first_event_time;
+    struct timeval virtual_time;
+    DocumentIndex *index;
+    bool virtual_clock;
 };
 
 namespace SMIL {
@@ -960,6 +1055,23 @@ public:
     QByteArray node_name;
 };
 
+/**
+ * Incremental XML reader, appends nodes to root while data arrives
+ */
+class KMPLAYERCOMMON_EXPORT XMLReader
+{
+public:
+    XMLReader (NodePtr root, bool set_opener=true);
+    ~XMLReader ();
+    void feed (const QString &data);
+    /**
+     * Parses remaining data and closes the open nodes
+     */
+    void finish ();
+private:
+    XMLReaderPrivate *d;
+};
+
 KMPLAYERCOMMON_EXPORT
 void readXML (NodePtr root, QTextStream & in, const QString & firstline, bool set_opener=true);
 KMPLAYERCOMMON_EXPORT Node * fromXMLDocumentTag (NodePtr & d, const QString & tag);
@@ -7,6 +7,8 @@
 #include <cmath>
 #include "config-kmplayer.h"
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <QString>
 #include <QFile>
 #include <QFileInfo>
@@ -26,6 +28,7 @@
 #include <QUrl>
 #include <QHeaderView>
 #include <QNetworkCookie>
+#include <QDBusUnixFileDescriptor>
 
 #include <KProtocolManager>
 #include <KMessageBox>
@@ -41,6 +44,8 @@
 #include "kmplayercontrolpanel.h"
 #include "kmplayerprocess.h"
 #include "kmplayerpartbase.h"
+#include "sharedframes.h"
+#include "surface.h"
 #include "masteradaptor.h"
 #include "streammasteradaptor.h"
 #ifdef KMPLAYER_WITH_NPP
@@ -260,15 +265,23 @@ void Process::rescheduledStateChanged () {
     }
 }
 
+static bool nonStdUrl (Mrl *m) {
+    return m->src.startsWith ("tv:/") ||
+        m->src.startsWith ("dvd:") ||
+        m->src.startsWith ("cdda:") ||
+        m->src.startsWith ("vcd:");
+}
+
+static QString playUrl (Mrl *m) {
+    return nonStdUrl (m) ? m->src : m->absolutePath ();
+}
+
 bool Process::play () {
     Mrl *m = mrl ();
     if (!m)
         return false;
-    bool nonstdurl = m->src.startsWith ("tv:/") ||
-        m->src.startsWith ("dvd:") ||
-        m->src.startsWith ("cdda:") ||
-        m->src.startsWith ("vcd:");
-    QString url = nonstdurl ? m->src : m->absolutePath ();
+    bool nonstdurl = nonStdUrl (m);
+    QString url = playUrl (m);
     bool changed = m_url != url;
     m_url = url;
     if (user) // FIXME: remove check
@@ -770,14 +783,20 @@ void MPlayer::processOutput () {
     QRegExp *patterns = static_cast<MPlayerPreferencesPage *>(process_info->config_page)->m_patterns;
     QRegExp & m_refURLRegExp = patterns[MPlayerPreferencesPage::pat_refurl];
     QRegExp & m_refRegExp = patterns[MPlayerPreferencesPage::pat_ref];
+    // status lines, terminated by a sole '\r', arrive many times a second
+    // and each one supersedes the previous of its kind, so only the last
+    // position and the last cache fill line of a run are converted and matched
+    enum { PositionStats, CacheStats, StatsKinds };
+    const char *stats[StatsKinds] = { nullptr, nullptr };
+    int stats_len[StatsKinds] = { 0, 0 };
+    QString stats_prefix[StatsKinds];
     do {
+        const char *line = str;
         int len = strcspn (str, "\r\n");
-        QString out = m_process_output + QString::fromLocal8Bit (str, len);
-        m_process_output = QString ();
         str += len;
         slen -= len;
         if (slen <= 0) {
-            m_process_output = out;
+            m_process_output += QString::fromLocal8Bit (line, len);
             break;
         }
         bool process_stats = false;
@@ -792,22 +811,23 @@ void MPlayer::processOutput () {
         slen--;
 
         if (process_stats) {
-            QRegExp & m_posRegExp = patterns[MPlayerPreferencesPage::pat_pos];
-            QRegExp & m_cacheRegExp = patterns[MPlayerPreferencesPage::pat_cache];
-            if (m_posRegExp.indexIn (out) > -1) {
-                if (m_source->hasLength ()) {
-                    int pos = int (10.0 * m_posRegExp.cap (1).toFloat ());
-                    m_source->setPosition (pos);
-                    m_request_seek = -1;
-                }
-                if (Playing == m_transition_state) {
-                    m_transition_state = NotRunning;
-                    setState (Playing);
-                }
-            } else if (m_cacheRegExp.indexIn (out) > -1) {
-                m_source->setLoading (int (m_cacheRegExp.cap(1).toDouble()));
+            int k = (m_process_output + QString::fromLatin1 (line, qMin (len, 5)))
+                .startsWith (QLatin1String ("Cache")) ? CacheStats : PositionStats;
+            stats[k] = line;
+            stats_len[k] = len;
+            stats_prefix[k] = m_process_output;
+            m_process_output = QString ();
+            continue;
+        }
+        for (int k = StatsKinds - 1; k >= 0; --k)
+            if (stats[k]) {
+                processStatusLine (stats_prefix[k] + QString::fromLocal8Bit (stats[k], stats_len[k]));
+                stats[k] = nullptr;
             }
-        } else if (out.startsWith ("ID_LENGTH")) {
+        QString out = m_process_output + QString::fromLocal8Bit (line, len);
+        m_process_output = QString ();
+
+        if (out.startsWith ("ID_LENGTH")) {
             int pos = out.indexOf ('=');
             if (pos > 0) {
                 int l = (int) out.mid (pos + 1).toDouble (&ok);
@@ -927,6 +947,28 @@ void MPlayer::processOutput () {
             }
         }
     } while (slen > 0);
+    for (int k = StatsKinds - 1; k >= 0; --k)
+        if (stats[k])
+            processStatusLine (stats_prefix[k] + QString::fromLocal8Bit (stats[k], stats_len[k]));
+}
+
+void MPlayer::processStatusLine (const QString &out) {
+    QRegExp *patterns = static_cast<MPlayerPreferencesPage *>(process_info->config_page)->m_patterns;
+    QRegExp & m_posRegExp = patterns[MPlayerPreferencesPage::pat_pos];
+    QRegExp & m_cacheRegExp = patterns[MPlayerPreferencesPage::pat_cache];
+    if (m_posRegExp.indexIn (out) > -1) {
+        if (m_source->hasLength ()) {
+            int pos = int (10.0 * m_posRegExp.cap (1).toFloat ());
+            m_source->setPosition (pos);
+            m_request_seek = -1;
+        }
+        if (Playing == m_transition_state) {
+            m_transition_state = NotRunning;
+            setState (Playing);
+        }
+    } else if (m_cacheRegExp.indexIn (out) > -1) {
+        m_source->setLoading (int (m_cacheRegExp.cap(1).toDouble()));
+    }
 }
 
 void MPlayer::processStopped () {
@@ -1242,7 +1284,11 @@ void MPlayerDumpstream::stop () {
 MasterProcessInfo::MasterProcessInfo (const char *nm, const QString &lbl,
             const char **supported, MediaManager *mgr, PreferencesPage *pp)
  : ProcessInfo (nm, lbl, supported, mgr, pp),
-   m_agent (nullptr) {}
+   m_agent (nullptr),
+   m_agent_hits (0),
+   m_agent_misses (0),
+   m_first_frame_msec (0),
+   m_first_frame_count (0) {}
 
 MasterProcessInfo::~MasterProcessInfo () {
     stopAgent ();
@@ -1270,6 +1316,11 @@ void MasterProcessInfo::quitProcesses () {
     stopAgent ();
 }
 
+void MasterProcessInfo::prestart () {
+    if (!processRunning (m_agent))
+        startAgent ();
+}
+
 void MasterProcessInfo::stopAgent ()
 {
     if (!m_agent_service.isEmpty ()) {
@@ -1313,19 +1364,50 @@ void MasterProcessInfo::agentOutput ()
 }
 
 MasterProcess::MasterProcess (QObject *parent, ProcessInfo *pinfo, Settings *settings)
- : Process (parent, pinfo, settings) {}
+ : Process (parent, pinfo, settings),
+   m_frames (nullptr), m_frames_size (0), m_export_frames (false) {}
 
 MasterProcess::~MasterProcess () {
+    unmapFrames ();
+}
+
+/* ask the agent to (not) copy frames into the shared buffer */
+void MasterProcess::exportFrames (bool enable) {
+    MasterProcessInfo *mpi = static_cast<MasterProcessInfo *>(process_info);
+    if (mpi->m_agent_service.isEmpty ()) { // agent gone, a new one starts off
+        m_export_frames = false;
+        return;
+    }
+    if (enable == m_export_frames)
+        return;
+    m_export_frames = enable;
+    QDBusMessage msg = QDBusMessage::createMethodCall (
+            mpi->m_agent_service,
+            m_agent_path,
+            "org.kde.kmplayer.StreamAgent",
+            "exportFrames");
+    msg << enable;
+    msg.setDelayedReply (false);
+    QDBusConnection::sessionBus().send (msg);
+}
+
+void MasterProcess::unmapFrames () {
+    if (m_frames) {
+        munmap (m_frames, m_frames_size);
+        m_frames = nullptr;
+        m_frames_size = 0;
+    }
 }
 
 void MasterProcess::init () {
 }
 
-bool MasterProcess::deMediafiedPlay () {
+/* method is newStream, or newPausedStream for preroll () */
+void MasterProcess::openStream (const char *method) {
     WindowId wid = user->viewer ()->windowHandle ();
     m_agent_path = QString ("/stream_%1").arg (wid);
     MasterProcessInfo *mpi = static_cast <MasterProcessInfo *>(process_info);
-    qCDebug(LOG_KMPLAYER_COMMON) << "MasterProcess::deMediafiedPlay " << m_url << " " << wid;
+    qCDebug(LOG_KMPLAYER_COMMON) << "MasterProcess::" << method << m_url << " " << wid;
 
     (void) new StreamMasterAdaptor (this);
     QDBusConnection::sessionBus().registerObject (
@@ -1333,7 +1415,7 @@ bool MasterProcess::deMediafiedPlay () {
 
     QDBusMessage msg = QDBusMessage::createMethodCall (
             mpi->m_agent_service, QString ("/%1").arg (process_info->name),
-                "org.kde.kmplayer.Agent", "newStream");
+                "org.kde.kmplayer.Agent", method);
     if (!m_url.startsWith ("dvd:") ||
             !m_url.startsWith ("vcd:") ||
             !m_url.startsWith ("cdda:")) {
@@ -1344,17 +1426,50 @@ bool MasterProcess::deMediafiedPlay () {
     msg << m_url << (qulonglong)wid;
     msg.setDelayedReply (false);
     QDBusConnection::sessionBus().send (msg);
+}
+
+bool MasterProcess::deMediafiedPlay () {
+    MasterProcessInfo *mpi = static_cast <MasterProcessInfo *>(process_info);
+    if (!m_prerolled.isEmpty () && m_prerolled == mpi->m_agent_service) {
+        // the stream waits paused since preroll (), the pause call toggles
+        QDBusMessage msg = QDBusMessage::createMethodCall (
+                mpi->m_agent_service,
+                m_agent_path,
+                "org.kde.kmplayer.StreamAgent",
+                "pause");
+        msg.setDelayedReply (false);
+        QDBusConnection::sessionBus().send (msg);
+    } else {
+        openStream ("newStream");
+    }
+    m_prerolled.clear ();
     setState (IProcess::Buffering);
     return true;
 }
 
+/*
+ * Opens the stream paused in the agent, so that play () only has to unpause
+ * it. Process::play () goes straight to deMediafiedPlay when m_url is kept.
+ */
+bool MasterProcess::preroll () {
+    MasterProcessInfo *mpi = static_cast <MasterProcessInfo *>(process_info);
+    Mrl *m = mrl ();
+    if (!m || !user || !user->viewer () || IProcess::Ready != m_state ||
+            mpi->m_agent_service.isEmpty () || !m_prerolled.isEmpty ())
+        return false;
+    m_url = playUrl (m);
+    openStream ("newPausedStream");
+    m_prerolled = mpi->m_agent_service;
+    return true;
+}
+
 bool MasterProcess::running () const {
     MasterProcessInfo *mpi = static_cast <MasterProcessInfo *>(process_info);
     return processRunning (mpi->m_agent);
 }
 
 void MasterProcess::loading (int perc) {
-    process_info->manager->player ()->setLoaded (perc);
+    process_info->manager->player ()->updateLoaded (perc);
 }
 
 void MasterProcess::streamInfo (uint64_t length, double aspect) {
@@ -1368,8 +1483,22 @@ void MasterProcess::streamMetaInfo (QString info) {
 }
 
 void MasterProcess::playing () {
+    if (m_first_frame.isValid ()) {
+        MasterProcessInfo *mpi = static_cast <MasterProcessInfo *>(process_info);
+        qint64 msec = m_first_frame.elapsed ();
+        m_first_frame.invalidate ();
+        mpi->m_first_frame_msec += msec;
+        mpi->m_first_frame_count++;
+        qCDebug(LOG_KMPLAYER_COMMON) << "first frame after" << msec << "ms, avg"
+            << mpi->m_first_frame_msec / mpi->m_first_frame_count
+            << "ms, agent reused" << mpi->m_agent_hits << "of"
+            << mpi->m_agent_hits + mpi->m_agent_misses;
+    }
     process_info->manager->player ()->setLoaded (100);
     setState (IProcess::Playing);
+    // composite into the SMIL region instead of overlaying a window
+    Mrl *m = mrl ();
+    exportFrames (m && Mrl::SingleMode != m->view_mode);
 }
 
 void MasterProcess::progress (uint64_t pos) {
@@ -1427,8 +1556,52 @@ void MasterProcess::eof () {
     setState (IProcess::Ready);
 }
 
+void MasterProcess::frameBuffer (const QDBusUnixFileDescriptor &fd,
+        uint width, uint height, uint stride, uint slots) {
+    unmapFrames ();
+    if (!fd.isValid () || !width || !height)
+        return;
+    size_t len = SharedFrames::size (stride, height, slots);
+    struct stat st;
+    if (slots > SharedFrames::MaxSlots ||
+            fstat (fd.fileDescriptor (), &st) || (size_t) st.st_size < len) {
+        // accessing pages past the end of the file raises SIGBUS
+        qCWarning(LOG_KMPLAYER_COMMON) << "frameBuffer too small";
+        return;
+    }
+    void *p = mmap (nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED,
+            fd.fileDescriptor (), 0);
+    if (MAP_FAILED == p) {
+        qCWarning(LOG_KMPLAYER_COMMON) << "frameBuffer mmap failed";
+        return;
+    }
+    SharedFrames *frames = (SharedFrames *) p;
+    if (!frames->valid (len) || frames->width != width ||
+            frames->height != height) {
+        qCWarning(LOG_KMPLAYER_COMMON) << "frameBuffer invalid header";
+        munmap (p, len);
+        return;
+    }
+    m_frames = frames;
+    m_frames_size = len;
+    // painted from the frames from now on, move the viewer out of sight once
+    if (user && user->viewer ())
+        user->viewer ()->setGeometry (IRect (-60, -60, 50, 50));
+    qCDebug(LOG_KMPLAYER_COMMON) << "frameBuffer" << width << "x" << height << slots;
+}
+
+void MasterProcess::frameReady (uint) {
+    Mrl *m = mrl ();
+    Surface *s = m && m_frames ? (Surface *) m->role (RoleDisplay) : nullptr;
+    if (s)
+        s->repaint ();
+}
+
 void MasterProcess::stop () {
-    if (m_state > IProcess::Ready) {
+    exportFrames (false);
+    bool prerolled = !m_prerolled.isEmpty ();
+    m_prerolled.clear ();
+    if (m_state > IProcess::Ready || prerolled) {
         MasterProcessInfo *mpi = static_cast<MasterProcessInfo *>(process_info);
         QDBusMessage msg = QDBusMessage::createMethodCall (
                 mpi->m_agent_service,
@@ -1451,8 +1624,12 @@ PhononProcessInfo::PhononProcessInfo (MediaManager *mgr)
 {}
 
 IProcess *PhononProcessInfo::create (PartBase *part, ProcessUser *usr) {
-    if (!processRunning (m_agent))
+    if (processRunning (m_agent)) {
+        m_agent_hits++;
+    } else {
+        m_agent_misses++;
         startAgent ();
+    }
     Phonon *p = new Phonon (part, this, part->settings ());
     p->setSource (part->source ());
     p->user = usr;
@@ -1479,6 +1656,7 @@ bool Phonon::ready () {
         user->viewer ()->useIndirectWidget (false);
     qCDebug(LOG_KMPLAYER_COMMON) << "Phonon::ready " << state () << endl;
     PhononProcessInfo *ppi = static_cast <PhononProcessInfo *>(process_info);
+    m_first_frame.start ();
     if (running ()) {
         if (!ppi->m_agent_service.isEmpty ())
             setState (IProcess::Ready);
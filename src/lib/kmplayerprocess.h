@@ -8,6 +8,7 @@
 #define _KMPLAYERPROCESS_H_
 
 #include <QObject>
+#include <QElapsedTimer>
 #include <QString>
 #include <QList>
 #include <QByteArray>
@@ -23,6 +24,7 @@
 #include "kmplayercommon_export.h"
 
 class QWidget;
+class QDBusUnixFileDescriptor;
 class KJob;
 
 namespace KIO {
@@ -166,6 +168,8 @@ protected:
 private Q_SLOTS:
     void processOutput () KMPLAYERCOMMON_NO_EXPORT;
 private:
+    void processStatusLine (const QString &line) KMPLAYERCOMMON_NO_EXPORT;
+
     QString m_process_output;
     QString m_grab_file;
     QString m_grab_dir;
@@ -278,6 +282,7 @@ public:
     ~MasterProcessInfo () override;
 
     void quitProcesses () override;
+    void prestart () override;
 
     void running (const QString &srv);
 
@@ -285,6 +290,12 @@ public:
     QString m_path;
     QString m_agent_service;
     QProcess *m_agent;
+    /* streams that found the agent already running, and those that didn't */
+    unsigned int m_agent_hits;
+    unsigned int m_agent_misses;
+    /* summed time from ready () to the first played frame */
+    qint64 m_first_frame_msec;
+    unsigned int m_first_frame_count;
 
 private Q_SLOTS:
     void agentStopped (int, QProcess::ExitStatus);
@@ -305,6 +316,7 @@ public:
 
     void init () override;
     bool deMediafiedPlay () override;
+    bool preroll () override;
     bool running () const override;
 
     void streamInfo (uint64_t length, double aspect);
@@ -318,9 +330,24 @@ public:
     void volume (int pos, bool absolute) override;
     void eof ();
     void stop () override;
+    void frameBuffer (const QDBusUnixFileDescriptor &fd,
+            uint width, uint height, uint stride, uint slots);
+    void frameReady (uint slot);
+    SharedFrames *sharedFrames () override { return m_frames; }
+
+protected:
+    QElapsedTimer m_first_frame;
 
 private:
+    void openStream (const char *method);
+    void exportFrames (bool enable);
+    void unmapFrames ();
+
     QString m_agent_path;
+    QString m_prerolled; // agent service holding the paused stream
+    SharedFrames *m_frames;
+    size_t m_frames_size;
+    bool m_export_frames;
 };
 
 class PhononProcessInfo : public MasterProcessInfo
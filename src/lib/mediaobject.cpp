@@ -12,12 +12,22 @@
 #include <QPainter>
 #include <QSvgRenderer>
 #include <QImage>
+#include <QImageReader>
+#include <QThreadPool>
 #include <QFile>
 #include <QUrl>
 #include <QTextCodec>
 #include <QTextStream>
 #include <QMimeDatabase>
 #include <QMimeType>
+#include <QDir>
+#include <QDateTime>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+
+#include <algorithm>
 
 #include <KLocalizedString>
 #include <KIO/Job>
@@ -29,6 +39,7 @@
 #include "expression.h"
 #include "viewarea.h"
 #include "kmplayerpartbase.h"
+#include "kmplayer_smil.h"
 #include "kmplayercommon_log.h"
 
 using namespace KMPlayer;
@@ -38,12 +49,14 @@ namespace {
     typedef QMap <QString, ImageDataPtrW> ImageDataMap;
 
     static DataCache *memory_cache;
+    static DiskCache *disk_cache;
     static ImageDataMap *image_data_map;
 
     struct GlobalMediaData : public GlobalShared<GlobalMediaData> {
         GlobalMediaData (GlobalMediaData **gb)
          : GlobalShared<GlobalMediaData> (gb) {
             memory_cache = new DataCache;
+            disk_cache = new DiskCache;
             image_data_map = new ImageDataMap;
         }
         ~GlobalMediaData () override;
@@ -53,6 +66,7 @@ namespace {
 
     GlobalMediaData::~GlobalMediaData () {
         delete memory_cache;
+        delete disk_cache;
         delete image_data_map;
         global_media = nullptr;
     }
@@ -165,6 +179,12 @@ MediaObject *MediaManager::createAVMedia (Node *node, const QByteArray &) {
     return av;
 }
 
+/* a prerolled process waits for its Mrl to be activated */
+static bool prerolled (IProcess *p) {
+    Mrl *mrl = p->user ? p->user->getMrl () : nullptr;
+    return mrl && !mrl->active ();
+}
+
 static const QString statemap [] = {
     i18n ("Not Running"), i18n ("Ready"), i18n ("Buffering"), i18n ("Playing"),  i18n ("Paused")
 };
@@ -217,12 +237,16 @@ void MediaManager::stateChange (AudioVideoMedia *media,
             playAudioVideo (media);
         } else if (AudioVideoMedia::ask_grab == media->request) {
             grabPicture (media);
+        } else if (AudioVideoMedia::ask_preroll == media->request) {
+            media->request = AudioVideoMedia::ask_nothing;
+            media->process->preroll ();
         } else {
             if (!is_rec && Mrl::SingleMode == mrl->view_mode) {
                 ProcessList::ConstIterator i, e = m_processes.constEnd ();
                 for (i = m_processes.constBegin(); i != e; ++i)
                     if (*i != media->process &&
-                            (*i)->state () == IProcess::Ready)
+                            (*i)->state () == IProcess::Ready &&
+                            !prerolled (*i))
                         (*i)->play (); // delayed playing
                 e = m_recorders.constEnd ();
                 for (i = m_recorders.constBegin (); i != e; ++i)
@@ -297,46 +321,317 @@ Mrl *MediaObject::mrl () {
 
 //------------------------%<----------------------------------------------------
 
+DataCache::DataCache ()
+ : lru_first (nullptr),
+   lru_last (nullptr),
+   cache_size (0),
+   max_size (32 * 1024 * 1024),
+   hit_count (0), miss_count (0), eviction_count (0) {}
+
+DataCache::~DataCache () {
+    qCDebug(LOG_KMPLAYER_COMMON) << "DataCache hits:" << hit_count << "misses:" <<
+        miss_count << "evictions:" << eviction_count << "size:" << cache_size;
+    while (lru_first)
+        remove (lru_first);
+}
+
+void DataCache::link (Entry *e) {
+    e->prev = nullptr;
+    e->next = lru_first;
+    if (lru_first)
+        lru_first->prev = e;
+    else
+        lru_last = e;
+    lru_first = e;
+}
+
+void DataCache::unlink (Entry *e) {
+    if (e->prev)
+        e->prev->next = e->next;
+    else
+        lru_first = e->next;
+    if (e->next)
+        e->next->prev = e->prev;
+    else
+        lru_last = e->prev;
+}
+
+void DataCache::remove (Entry *e) {
+    unlink (e);
+    cache_map.remove (e->url);
+    cache_size -= e->data.size ();
+    delete e;
+}
+
+void DataCache::evict (Entry *keep) {
+    Entry *e = lru_last;
+    while (e && cache_size > max_size) {
+        Entry *prev = e->prev;
+        if (e != keep && !preserve_set.contains (e->url)) {
+            remove (e);
+            eviction_count++;
+        }
+        e = prev;
+    }
+}
+
+void DataCache::setMaxSize (qint64 bytes) {
+    max_size = bytes;
+    evict (nullptr);
+}
+
 void DataCache::add (const QString & url, const QString &mime, const QByteArray & data) {
-    QByteArray bytes;
-    bytes = data;
-    cache_map.insert (url, qMakePair (mime, bytes));
-    preserve_map.remove (url);
+    DataMap::iterator it = cache_map.find (url);
+    if (it != cache_map.end ())
+        remove (it.value ());
+    Entry *e = new Entry;
+    e->url = url;
+    e->mime = mime;
+    e->data = data;
+    link (e);
+    cache_map.insert (url, e);
+    cache_size += data.size ();
+    evict (e);
+    preserve_set.remove (url);
     Q_EMIT preserveRemoved (url);
 }
 
 bool DataCache::get (const QString & url, QString &mime, QByteArray & data) {
     DataMap::const_iterator it = cache_map.constFind (url);
     if (it != cache_map.constEnd ()) {
-        mime = it.value ().first;
-        data = it.value ().second;
+        Entry *e = it.value ();
+        if (e != lru_first) {
+            unlink (e);
+            link (e);
+        }
+        mime = e->mime;
+        data = e->data;
+        hit_count++;
         return true;
     }
+    miss_count++;
     return false;
 }
 
 bool DataCache::preserve (const QString & url) {
-    PreserveMap::const_iterator it = preserve_map.constFind (url);
-    if (it == preserve_map.constEnd ()) {
-        preserve_map.insert (url, true);
+    if (!preserve_set.contains (url)) {
+        preserve_set.insert (url);
         return true;
     }
     return false;
 }
 
 bool DataCache::isPreserved (const QString & url) {
-    return preserve_map.find (url) != preserve_map.end ();
+    return preserve_set.contains (url);
 }
 
 bool DataCache::unpreserve (const QString & url) {
-    const PreserveMap::iterator it = preserve_map.find (url);
-    if (it == preserve_map.end ())
+    if (!preserve_set.remove (url))
         return false;
-    preserve_map.erase (it);
     Q_EMIT preserveRemoved (url);
     return true;
 }
 
+DataCache *MediaManager::memoryCache () const {
+    return memory_cache;
+}
+
+DiskCache *MediaManager::diskCache () const {
+    return disk_cache;
+}
+
+//------------------------%<----------------------------------------------------
+
+static const quint32 disk_cache_version = 2;
+
+DiskCache::DiskCache ()
+ : path (QStandardPaths::writableLocation (QStandardPaths::GenericCacheLocation)
+         + QStringLiteral ("/kmplayer/media")),
+   store_size (0),
+   max_size (256 * 1024 * 1024),
+   loaded (false),
+   dirty (false) {
+    // index writes are batched, a burst of downloads gives one save
+    save_timer.setSingleShot (true);
+    save_timer.setInterval (5000);
+    QObject::connect (&save_timer, &QTimer::timeout, [this] () {
+        if (dirty)
+            save ();
+    });
+}
+
+DiskCache::~DiskCache () {
+    if (dirty)
+        save ();
+}
+
+QString DiskCache::blobPath (const QByteArray &hash) const {
+    return path + QChar ('/') + QString::fromLatin1 (hash.toHex ());
+}
+
+void DiskCache::load () {
+    loaded = true;
+    QFile file (path + QStringLiteral ("/index"));
+    if (!file.open (QIODevice::ReadOnly))
+        return;
+    QDataStream in (&file);
+    quint32 version;
+    qint32 count;
+    in >> version >> count;
+    if (version != disk_cache_version)
+        return;
+    for (int i = 0; i < count && in.status () == QDataStream::Ok; ++i) {
+        QString url;
+        Entry e;
+        in >> url >> e.hash >> e.mime >> e.etag >> e.modified >> e.size
+            >> e.stamp >> e.expires;
+        if (in.status () == QDataStream::Ok && QFile::exists (blobPath (e.hash))) {
+            index.insert (url, e);
+            ref (e);
+        }
+    }
+}
+
+void DiskCache::save () {
+    dirty = false;
+    save_timer.stop ();
+    QSaveFile file (path + QStringLiteral ("/index"));
+    if (!file.open (QIODevice::WriteOnly))
+        return;
+    QDataStream out (&file);
+    out << disk_cache_version << (qint32) index.size ();
+    const IndexMap::const_iterator e = index.constEnd ();
+    for (IndexMap::const_iterator i = index.constBegin (); i != e; ++i)
+        out << i.key () << i->hash << i->mime << i->etag << i->modified
+            << i->size << i->stamp << i->expires;
+    file.commit ();
+}
+
+void DiskCache::scheduleSave () {
+    dirty = true;
+    if (!save_timer.isActive ())
+        save_timer.start ();
+}
+
+/* urls with the same content share a blob, its size is counted once */
+void DiskCache::ref (const Entry &e) {
+    if (!blob_refs[e.hash]++)
+        store_size += e.size;
+}
+
+void DiskCache::unref (const Entry &e) {
+    BlobRefs::iterator it = blob_refs.find (e.hash);
+    if (it == blob_refs.end () || --*it > 0)
+        return;
+    blob_refs.erase (it);
+    store_size -= e.size;
+    QFile::remove (blobPath (e.hash));
+}
+
+void DiskCache::evict () {
+    if (store_size <= max_size)
+        return;
+    QVector <QPair <qint64, QString> > order; // stamp, url
+    const IndexMap::const_iterator e = index.constEnd ();
+    for (IndexMap::const_iterator i = index.constBegin (); i != e; ++i)
+        order.append (qMakePair (i->stamp, i.key ()));
+    std::sort (order.begin (), order.end ());
+    for (int i = 0; i < order.size () && store_size > max_size; ++i) {
+        IndexMap::iterator it = index.find (order[i].second);
+        unref (*it);
+        index.erase (it);
+    }
+}
+
+void DiskCache::setMaxSize (qint64 bytes) {
+    if (bytes == max_size)
+        return;
+    max_size = bytes;
+    if (!loaded)
+        load ();
+    qint64 old_size = store_size;
+    evict ();
+    if (store_size != old_size)
+        scheduleSave ();
+}
+
+bool DiskCache::validators (const QString &url, QString &etag, QString &modified) {
+    if (!loaded)
+        load ();
+    IndexMap::const_iterator it = index.constFind (url);
+    if (it == index.constEnd ())
+        return false;
+    etag = it->etag;
+    modified = it->modified;
+    return true;
+}
+
+bool DiskCache::fresh (const QString &url) {
+    if (!loaded)
+        load ();
+    IndexMap::const_iterator it = index.constFind (url);
+    return it != index.constEnd () &&
+        it->expires > QDateTime::currentSecsSinceEpoch ();
+}
+
+void DiskCache::refresh (const QString &url, qint64 expires) {
+    IndexMap::iterator it = index.find (url);
+    if (it != index.end () && it->expires != expires) {
+        it->expires = expires;
+        scheduleSave ();
+    }
+}
+
+bool DiskCache::get (const QString &url, QString &mime, QByteArray &data) {
+    if (!loaded)
+        load ();
+    IndexMap::iterator it = index.find (url);
+    if (it == index.end ())
+        return false;
+    QFile file (blobPath (it->hash));
+    if (!file.open (QIODevice::ReadOnly) || file.size () != it->size)
+        return false;
+    data = file.readAll ();
+    mime = it->mime;
+    it->stamp = QDateTime::currentSecsSinceEpoch ();
+    scheduleSave (); // keep the LRU order over restarts
+    return true;
+}
+
+void DiskCache::add (const QString &url, const QString &mime,
+        const QByteArray &data, const QString &etag, const QString &modified,
+        qint64 expires) {
+    if (!loaded)
+        load ();
+    if (data.size () > max_size / 4 || !QDir ().mkpath (path))
+        return;
+    Entry e;
+    e.hash = QCryptographicHash::hash (data, QCryptographicHash::Sha1);
+    e.mime = mime;
+    e.etag = etag;
+    e.modified = modified;
+    e.size = data.size ();
+    e.stamp = QDateTime::currentSecsSinceEpoch ();
+    e.expires = expires;
+    QString blob = blobPath (e.hash);
+    if (!QFile::exists (blob)) {
+        QSaveFile file (blob);
+        if (!file.open (QIODevice::WriteOnly) ||
+                file.write (data) != data.size () || !file.commit ())
+            return;
+    }
+    ref (e);
+    IndexMap::iterator it = index.find (url);
+    if (it != index.end ()) {
+        unref (*it); // the old blob goes when no other url has it
+        *it = e;
+    } else {
+        index.insert (url, e);
+    }
+    evict ();
+    scheduleSave ();
+}
+
 //------------------------%<----------------------------------------------------
 
 static bool isPlayListMime (const QString & mime) {
@@ -374,6 +669,48 @@ static bool isPlayListMime (const QString & mime) {
             !strcmp (mimestr, "application/x-mplayer2"));
 }
 
+/*
+ * Validators and the freshness lifetime from the HTTP response headers,
+ * expires is 0 when the response must be revalidated before reuse
+ */
+static void parseCacheHeaders (const QString &headers, QString &etag,
+        QString &modified, qint64 &expires) {
+    const QStringList lines = headers.split (QChar ('\n'));
+    qint64 max_age = -1;
+    bool no_cache = false;
+    QDateTime expires_date;
+    for (int i = 0; i < lines.size (); ++i) {
+        const QString h = lines[i].trimmed ();
+        if (h.startsWith (QString ("etag:"), Qt::CaseInsensitive)) {
+            etag = h.mid (5).trimmed ();
+        } else if (h.startsWith (QString ("last-modified:"), Qt::CaseInsensitive)) {
+            modified = h.mid (14).trimmed ();
+        } else if (h.startsWith (QString ("expires:"), Qt::CaseInsensitive)) {
+            QString date = h.mid (8).trimmed ();
+            if (date.endsWith (QString ("GMT"))) // HTTP dates are always GMT
+                date = date.left (date.size () - 3) + "+0000";
+            expires_date = QDateTime::fromString (date, Qt::RFC2822Date);
+        } else if (h.startsWith (QString ("cache-control:"), Qt::CaseInsensitive)) {
+            const QStringList directives = h.mid (14).split (QChar (','));
+            for (int j = 0; j < directives.size (); ++j) {
+                const QString d = directives[j].trimmed ().toLower ();
+                if (d == "no-cache" || d == "no-store")
+                    no_cache = true;
+                else if (d.startsWith (QString ("max-age=")))
+                    max_age = d.mid (8).toLongLong ();
+            }
+        }
+    }
+    qint64 now = QDateTime::currentSecsSinceEpoch ();
+    expires = 0;
+    if (no_cache)
+        return;
+    if (max_age >= 0) // overrides Expires
+        expires = max_age > 0 ? now + max_age : 0;
+    else if (expires_date.isValid () && expires_date.toSecsSinceEpoch () > now)
+        expires = expires_date.toSecsSinceEpoch ();
+}
+
 static QString mimeByContent (const QByteArray &data)
 {
     const QMimeType mimeType = QMimeDatabase().mimeTypeForData(data);
@@ -384,7 +721,9 @@ static QString mimeByContent (const QByteArray &data)
 
 MediaInfo::MediaInfo (Node *n, MediaManager::MediaType t)
  : media (nullptr), type (t), node (n), job (nullptr),
-    preserve_wait (false), check_access (false) {
+    xml_reader (nullptr), text_decoder (nullptr),
+    preserve_wait (false), check_access (false),
+    stream_checked (false), child_doc_read (false), ready_posted (false) {
 }
 
 MediaInfo::~MediaInfo () {
@@ -396,6 +735,7 @@ void MediaInfo::killWGet () {
         job->kill (); // quiet, no result signal
         job = nullptr;
         memory_cache->unpreserve (url);
+        finishChildDoc (false);
     } else if (preserve_wait) {
         disconnect (memory_cache, &DataCache::preserveRemoved,
                     this, &MediaInfo::cachePreserveRemoved);
@@ -518,12 +858,33 @@ bool MediaInfo::wget(const QString& str, const QString& domain) {
             ready ();
             return true;
         }
+        if (MediaManager::Data != type && protocol.startsWith ("http") &&
+                disk_cache->fresh (str) && disk_cache->get (str, mime, data)) {
+            // stored copy is still fresh, the server needn't be asked
+            setMimetype (mime);
+            memory_cache->add (str, mime, data);
+            if (MediaManager::Any == type)
+                type = MediaManager::AudioVideo;
+            ready ();
+            return true;
+        }
     }
     if (check_access || memory_cache->preserve (str)) {
         //qCDebug(LOG_KMPLAYER_COMMON) << "downloading " << str;
         job = KIO::get (kurl, KIO::NoReload, KIO::HideProgressInfo);
         job->addMetaData ("PropagateHttpHeader", "true");
         job->addMetaData ("errorPage", "false");
+        QString etag, modified;
+        if (!check_access && MediaManager::Data != type &&
+                protocol.startsWith ("http") &&
+                disk_cache->validators (str, etag, modified)) {
+            QStringList headers;
+            if (!etag.isEmpty ())
+                headers << QString ("If-None-Match: ") + etag;
+            if (!modified.isEmpty ())
+                headers << QString ("If-Modified-Since: ") + modified;
+            job->addMetaData ("customHTTPHeader", headers.join ("\r\n"));
+        }
         connect (job, &KIO::TransferJob::data,
                 this, &MediaInfo::slotData);
         connect (job, &KJob::result,
@@ -669,6 +1030,7 @@ void MediaInfo::clearData () {
     mime.truncate (0);
     access_from.truncate (0);
     data.resize (0);
+    stream_checked = child_doc_read = ready_posted = false;
 }
 
 bool MediaInfo::downloading () const {
@@ -682,8 +1044,12 @@ void MediaInfo::create () {
         case MediaManager::Audio:
         case MediaManager::AudioVideo:
             qCDebug(LOG_KMPLAYER_COMMON) << data.size ();
-            if (!data.size () || !readChildDoc ())
+            if (child_doc_read) {
+                if (node->isPlayable ())
+                    media = mgr->createAVMedia (node, data);
+            } else if (!data.size () || !readChildDoc ()) {
                 media = mgr->createAVMedia (node, data);
+            }
             break;
         case MediaManager::Image:
             if (data.size () && mime == "image/svg+xml") {
@@ -713,7 +1079,9 @@ void MediaInfo::create () {
 void MediaInfo::ready () {
     if (MediaManager::Data != type) {
         create ();
-        if (id_node_record_document == node->id)
+        if (ready_posted) // already sent while streaming
+            ready_posted = false;
+        else if (id_node_record_document == node->id)
             node->message (MsgMediaReady);
         else
             node->document()->post (node, new Posting (node, MsgMediaReady));
@@ -769,13 +1137,30 @@ void MediaInfo::slotResult (KJob *kjob) {
             ready ();
         }
     } else {
-        if (MediaManager::Data != type && !kjob->error ()) {
+        finishChildDoc (!kjob->error ());
+        KIO::Job *kiojob = static_cast <KIO::Job *> (kjob);
+        bool not_modified = kiojob->queryMetaData ("responsecode") == "304";
+        bool failed = kjob->error () && KJob::KilledJobError != kjob->error ();
+        QString stored_mime, etag, modified;
+        qint64 expires;
+        parseCacheHeaders (kiojob->queryMetaData ("HTTP-Headers"),
+                etag, modified, expires);
+        if (MediaManager::Data != type && (not_modified || failed) &&
+                disk_cache->get (url, stored_mime, data)) {
+            // unchanged or unreachable, use the stored copy
+            if (not_modified)
+                disk_cache->refresh (url, expires);
+            setMimetype (stored_mime);
+            memory_cache->add (url, mime, data);
+        } else if (MediaManager::Data != type && !kjob->error ()) {
             if (data.size () && data.size () < 512) {
                 setMimetype (mimeByContent (data));
                 if (!validDataFormat (type, data))
                     data.resize (0);
             }
             memory_cache->add (url, mime, data);
+            if (data.size () && (!etag.isEmpty () || !modified.isEmpty () || expires))
+                disk_cache->add (url, mime, data, etag, modified, expires);
         } else {
             memory_cache->unpreserve (url);
             if (MediaManager::Data != type)
@@ -808,6 +1193,85 @@ void MediaInfo::slotData (KIO::Job *, const QByteArray &qb) {
                 return;
             }
         }
+        if (!check_access && newsize >= 512)
+            streamChildDoc (old_size);
+    }
+}
+
+static Node *firstClosedMrl (Node *n) {
+    for (Node *c = n->firstChild (); c; c = c->nextSibling ()) {
+        if (c->isPlayable ())
+            return c->open ? nullptr : c;
+        Node *m = firstClosedMrl (c);
+        if (m)
+            return m;
+    }
+    return nullptr;
+}
+
+/**
+ * Reads XML playlists while downloading, so the first items can be shown
+ * and played before the tail has arrived
+ */
+void MediaInfo::streamChildDoc (int offset) {
+    if (!xml_reader) {
+        if (stream_checked)
+            return;
+        stream_checked = true;
+        Mrl *mrl = node->mrl ();
+        if ((MediaManager::Audio != type && MediaManager::AudioVideo != type) ||
+                !mrl || mrl->mimetype == QString ("audio/x-scpls"))
+            return;
+        QTextCodec *codec = QTextCodec::codecForUtfText (data,
+                QTextCodec::codecForLocale ());
+        if (!codec->toUnicode (data.left (512)).trimmed ().startsWith (QChar ('<')))
+            return;
+        text_decoder = codec->makeDecoder ();
+        xml_reader = new XMLReader (node);
+        offset = 0;
+    }
+    Document *doc = node->document ();
+    unsigned int tree_version = doc->m_tree_version;
+    xml_reader->feed (text_decoder->toUnicode (data.constData () + offset,
+                data.size () - offset));
+    if (tree_version != doc->m_tree_version) {
+        MediaManager *mgr = (MediaManager *) doc->role (RoleMediaManager);
+        if (mgr)
+            mgr->player ()->updateTree ();
+        Node *first = node->firstChild ();
+        if (!ready_posted && Node::state_deferred == node->state && first &&
+                (first->id < SMIL::id_node_first ||
+                 first->id >= SMIL::id_node_last) && // need the whole doc
+                firstClosedMrl (node)) {
+            ready_posted = true;
+            doc->post (node, new Posting (node, MsgMediaReady));
+        }
+    }
+}
+
+/**
+ * Ends streaming, a failed or killed download drops the streamed nodes so
+ * create() reads the complete data, eg. the stored copy, instead
+ */
+void MediaInfo::finishChildDoc (bool complete) {
+    if (xml_reader) {
+        xml_reader->finish ();
+        delete xml_reader;
+        xml_reader = nullptr;
+        delete text_decoder;
+        text_decoder = nullptr;
+        if (complete) {
+            child_doc_read = true;
+        } else {
+            while (node->lastChild ()) {
+                NodePtr c = node->lastChild ();
+                node->removeChild (c);
+                if (Node::state_init != c->state)
+                    c->reset ();
+            }
+            child_doc_read = false;
+            ready_posted = false; // the nodes it was sent for are gone
+        }
     }
 }
 
@@ -879,6 +1343,15 @@ bool AudioVideoMedia::play () {
     return false;
 }
 
+void AudioVideoMedia::preroll () {
+    if (process) {
+        if (process->state () == IProcess::Ready)
+            process->preroll ();
+        else if (ask_nothing == request)
+            request = ask_preroll;
+    }
+}
+
 bool AudioVideoMedia::grabPicture (const QString &file, int frame) {
     if (process) {
         qCDebug(LOG_KMPLAYER_COMMON) << "AudioVideoMedia::grab " << file << endl;
@@ -973,6 +1446,7 @@ ImageData::ImageData( const QString & img)
    image (nullptr),
 #ifdef KMPLAYER_WITH_CAIRO
    surface (nullptr),
+   scaled (nullptr),
 #endif
    url (img) {
     //if (img.isEmpty ())
@@ -985,6 +1459,7 @@ ImageData::~ImageData() {
     if (!url.isEmpty ())
         image_data_map->remove (url);
 #ifdef KMPLAYER_WITH_CAIRO
+    clearScaled ();
     if (surface)
         cairo_surface_destroy (surface);
 #endif
@@ -995,6 +1470,7 @@ void ImageData::setImage (QImage *img) {
     if (image != img) {
         delete image;
 #ifdef KMPLAYER_WITH_CAIRO
+        clearScaled ();
         if (surface) {
             cairo_surface_destroy (surface);
             surface = nullptr;
@@ -1011,13 +1487,50 @@ void ImageData::setImage (QImage *img) {
     }
 }
 
+ImageDecodeJob::ImageDecodeJob (const QByteArray &d, const QString &u)
+ : data (d), url (u) {
+    setAutoDelete (false);
+}
+
+void ImageDecodeJob::run () {
+    QBuffer buf (&data);
+    QImageReader reader (&buf);
+    bool animated = reader.supportsAnimation () && reader.imageCount () > 1;
+    buf.close ();
+    QImage image;
+    image.loadFromData (data);
+    if (!animated && !image.isNull () && image.depth () < 24)
+        image = image.convertToFormat (QImage::Format_RGB32); // as copyImage
+    Q_EMIT decoded (image, animated, url);
+    deleteLater ();
+}
+
+/*
+ * Images needed soonest are decoded first. Elements that already began
+ * and wait for their media go before those still waiting on a begin timer.
+ */
+static int decodePriority (Node *node) {
+    Runtime *rt = node ? (Runtime *) node->role (RoleTiming) : nullptr;
+    if (!rt)
+        return 0;
+    if (rt->timingstate >= Runtime::timings_began)
+        return 100;
+    if (rt->begin_timer) {
+        int ms = node->document ()->remainingTime (rt->begin_timer);
+        if (ms >= 0)
+            return qMax (1, 99 - ms / 100);
+    }
+    return 0;
+}
+
 ImageMedia::ImageMedia (MediaManager *manager, Node *node,
         const QString &url, const QByteArray &ba)
  : MediaObject (manager, node), data (ba), buffer (nullptr),
    img_movie (nullptr),
    svg_renderer (nullptr),
    update_render (false),
-   paused (false) {
+   paused (false),
+   play_pending (false) {
     setupImage (url);
 }
 
@@ -1027,7 +1540,9 @@ ImageMedia::ImageMedia (Node *node, ImageDataPtr id)
    buffer (nullptr),
    img_movie (nullptr),
    svg_renderer (nullptr),
-   update_render (false) {
+   update_render (false),
+   paused (false),
+   play_pending (false) {
     if (!id) {
         Node *c = findChildWithId (node, id_node_svg);
         if (c) {
@@ -1049,14 +1564,18 @@ ImageMedia::ImageMedia (Node *node, ImageDataPtr id)
 }
 
 ImageMedia::~ImageMedia () {
+    if (decode_job && QThreadPool::globalInstance ()->tryTake (decode_job))
+        delete decode_job;
     delete img_movie;
     delete svg_renderer;
     delete buffer;
 }
 
 bool ImageMedia::play () {
-    if (!img_movie)
+    if (!img_movie) {
+        play_pending = !!decode_job;
         return false;
+    }
     if (img_movie->state () == QMovie::Paused)
         img_movie->setPaused (false);
     else if (img_movie->state () != QMovie::Running)
@@ -1065,6 +1584,7 @@ bool ImageMedia::play () {
 }
 
 void ImageMedia::stop () {
+    play_pending = false;
     pause ();
 }
 
@@ -1088,36 +1608,51 @@ void ImageMedia::unpause () {
 
 void ImageMedia::setupImage (const QString &url) {
     if (isEmpty () && data.size ()) {
-        QImage *pix = new QImage;
-        if (pix->loadFromData((data))) {
-            cached_img = ImageDataPtr (new ImageData (url));
-            cached_img->setImage (pix);
-        } else {
-            delete pix;
+        // only read the header here, the pixels are decoded on a pool
+        // thread, until then the region shows its background
+        QBuffer header (&data);
+        QImageReader reader (&header);
+        QSize sz = reader.size ();
+        header.close ();
+        cached_img = ImageDataPtr (new ImageData (url));
+        if (sz.isValid ()) {
+            cached_img->width = sz.width ();
+            cached_img->height = sz.height ();
         }
+        decode_job = new ImageDecodeJob (data, url);
+        connect (decode_job.data (), &ImageDecodeJob::decoded,
+                this, &ImageMedia::imageDecoded);
+        QThreadPool::globalInstance ()->start (decode_job,
+                decodePriority (m_node));
+    }
+}
+
+void ImageMedia::imageDecoded (const QImage &img, bool animated, const QString &url) {
+    decode_job = nullptr;
+    if (img.isNull ()) {
+        cached_img = nullptr;
+        return;
     }
-    if (!isEmpty ()) {
+    cached_img->setImage (new QImage (img));
+    frame_nr = 0;
+    if (animated) {
         buffer = new QBuffer (&data);
         img_movie = new QMovie (buffer);
-        //qCDebug(LOG_KMPLAYER_COMMON) << img_movie->frameCount ();
-        if (img_movie->frameCount () > 1) {
-            cached_img->flags |= (short)ImageData::ImagePixmap | ImageData::ImageAnimated;
-            connect (img_movie, &QMovie::updated,
-                    this, &ImageMedia::movieUpdated);
-            connect (img_movie, &QMovie::stateChanged,
-                    this, &ImageMedia::movieStatus);
-            connect (img_movie, &QMovie::resized,
-                    this, &ImageMedia::movieResize);
-        } else {
-            delete img_movie;
-            img_movie = nullptr;
-            delete buffer;
-            buffer = nullptr;
-            frame_nr = 0;
-            cached_img->flags |= (short)ImageData::ImagePixmap;
-            image_data_map->insert (url, ImageDataPtrW (cached_img));
-        }
+        cached_img->flags |= (short)ImageData::ImagePixmap | ImageData::ImageAnimated;
+        connect (img_movie, &QMovie::updated,
+                this, &ImageMedia::movieUpdated);
+        connect (img_movie, &QMovie::stateChanged,
+                this, &ImageMedia::movieStatus);
+        connect (img_movie, &QMovie::resized,
+                this, &ImageMedia::movieResize);
+        if (play_pending && !paused)
+            img_movie->start ();
+    } else {
+        cached_img->flags |= (short)ImageData::ImagePixmap;
+        image_data_map->insert (url, ImageDataPtrW (cached_img));
     }
+    if (m_node)
+        m_node->document ()->post (m_node, new Posting (m_node, MsgMediaUpdated));
 }
 
 void ImageMedia::render (const ISize &sz) {
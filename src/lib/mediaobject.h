@@ -13,18 +13,24 @@
 #include <QObject>
 #include <QPair>
 #include <QMap>
+#include <QHash>
+#include <QSet>
 #include <QString>
 #include <QMovie>
 #include <QList>
+#include <QImage>
+#include <QPointer>
+#include <QRunnable>
+#include <QTimer>
 
 #include "kmplayercommon_export.h"
 #include "kmplayerplaylist.h"
 
 class QMovie;
-class QImage;
 class QSvgRenderer;
 class QBuffer;
 class QByteArray;
+class QTextDecoder;
 class KJob;
 namespace KIO {
     class Job;
@@ -43,6 +49,9 @@ class PreferencesPage;
 class MediaObject;
 class CalculatedSizer;
 class Surface;
+class DataCache;
+class DiskCache;
+struct SharedFrames;
 
 
 class KMPLAYERCOMMON_EXPORT IProcess
@@ -54,6 +63,8 @@ public:
 
     virtual bool ready () = 0;
     virtual bool play () = 0;
+    /* open the stream paused ahead of play (), if the backend can */
+    virtual bool preroll () { return false; }
     virtual void pause () = 0;
     virtual void unpause () = 0;
     virtual bool grabPicture (const QString &file, int frame) = 0;
@@ -70,6 +81,8 @@ public:
     virtual void setAudioLang (int id) = 0;
     virtual void setSubtitle (int id) = 0;
     virtual bool running () const = 0;
+    /* frames exported by the backend, if any, for compositing */
+    virtual SharedFrames *sharedFrames () { return nullptr; }
 
     State state () const { return m_state; }
     ProcessUser *user;
@@ -106,6 +119,8 @@ public:
     bool supports (const char *source) const;
     virtual IProcess *create (PartBase*, ProcessUser*) = 0;
     virtual void quitProcesses () {};
+    /* start a backend that serves several streams before it's needed */
+    virtual void prestart () {}
 
     const char *name;
     QString label;
@@ -142,6 +157,8 @@ public:
     ProcessList &recorders () { return m_recorders; }
     MediaList &medias () { return m_media_objects; }
     PartBase *player () const { return m_player; }
+    DataCache *memoryCache () const;
+    DiskCache *diskCache () const KMPLAYERCOMMON_NO_EXPORT;
 
 private:
     MediaList m_media_objects;
@@ -159,25 +176,100 @@ private:
  * Abstract base of MediaObject types, handles downloading
  */
 
-class DataCache : public QObject
+/*
+ * Downloaded data shared by url, least recently used entries are removed
+ * when the cache grows beyond its maximum size. Urls being downloaded are
+ * preserved, and not evicted.
+ */
+class KMPLAYERCOMMON_EXPORT DataCache : public QObject
 {
     Q_OBJECT
-    typedef QMap <QString, QPair <QString, QByteArray> > DataMap;
-    typedef QMap <QString, bool> PreserveMap;
+    struct Entry {
+        QString url;
+        QString mime;
+        QByteArray data;
+        Entry *prev;
+        Entry *next;
+    };
+    typedef QHash <QString, Entry *> DataMap;
+    typedef QSet <QString> PreserveSet;
     DataMap cache_map;
-    PreserveMap preserve_map;
+    PreserveSet preserve_set;
+    Entry *lru_first; // most recently used
+    Entry *lru_last;
+    qint64 cache_size;
+    qint64 max_size;
+    unsigned int hit_count;
+    unsigned int miss_count;
+    unsigned int eviction_count;
+
+    void link (Entry *e);
+    void unlink (Entry *e);
+    void remove (Entry *e);
+    void evict (Entry *keep);
 public:
-    DataCache () {}
-    ~DataCache () override {}
+    DataCache ();
+    ~DataCache () override;
     void add (const QString &, const QString &, const QByteArray &);
     bool get (const QString &, QString &, QByteArray &);
     bool preserve (const QString &);
     bool unpreserve (const QString &);
     bool isPreserved (const QString &);
+    void setMaxSize (qint64 bytes);
+    qint64 maxSize () const { return max_size; }
+    qint64 size () const { return cache_size; }
+    unsigned int hits () const { return hit_count; }
+    unsigned int misses () const { return miss_count; }
+    unsigned int evictions () const { return eviction_count; }
 Q_SIGNALS:
     void preserveRemoved (const QString &); // ready or canceled
 };
 
+/*
+ * Persistent store of downloaded data with HTTP validators. Data is kept in
+ * content addressed files, an index maps the urls to these.
+ */
+class DiskCache
+{
+    struct Entry {
+        QByteArray hash;
+        QString mime;
+        QString etag;
+        QString modified;
+        qint64 size;
+        qint64 stamp;
+        qint64 expires; // fresh until, no revalidation needed
+    };
+    typedef QHash <QString, Entry> IndexMap;
+    typedef QHash <QByteArray, int> BlobRefs;
+    IndexMap index;
+    BlobRefs blob_refs; // urls per content hash
+    QString path;
+    QTimer save_timer;
+    qint64 store_size;
+    qint64 max_size;
+    bool loaded;
+    bool dirty;
+
+    void load ();
+    void save ();
+    void scheduleSave ();
+    void ref (const Entry &e);
+    void unref (const Entry &e);
+    void evict ();
+    QString blobPath (const QByteArray &hash) const;
+public:
+    DiskCache ();
+    ~DiskCache ();
+    bool validators (const QString &url, QString &etag, QString &modified);
+    bool fresh (const QString &url);
+    void refresh (const QString &url, qint64 expires);
+    bool get (const QString &url, QString &mime, QByteArray &data);
+    void add (const QString &url, const QString &mime, const QByteArray &data,
+            const QString &etag, const QString &modified, qint64 expires);
+    void setMaxSize (qint64 bytes);
+};
+
 class KMPLAYERCOMMON_EXPORT MediaObject : public QObject
 {
     Q_OBJECT
@@ -233,14 +325,21 @@ private Q_SLOTS:
 private:
     void ready() KMPLAYERCOMMON_NO_EXPORT;
     bool readChildDoc() KMPLAYERCOMMON_NO_EXPORT;
+    void streamChildDoc(int offset) KMPLAYERCOMMON_NO_EXPORT;
+    void finishChildDoc(bool complete) KMPLAYERCOMMON_NO_EXPORT;
     void setMimetype(const QString&) KMPLAYERCOMMON_NO_EXPORT;
 
     Node *node;
     KIO::TransferJob *job;
+    XMLReader *xml_reader;
+    QTextDecoder *text_decoder;
     QString cross_domain;
     QString access_from;
     bool preserve_wait;
     bool check_access;
+    bool stream_checked;
+    bool child_doc_read;
+    bool ready_posted;
 };
 
 //------------------------%<----------------------------------------------------
@@ -282,7 +381,8 @@ class AudioVideoMedia : public MediaObject, ProcessUser
     friend class MediaManager;
 public:
     enum Request {
-        ask_nothing, ask_play, ask_pause, ask_grab, ask_stop, ask_delete
+        ask_nothing, ask_play, ask_pause, ask_grab, ask_stop, ask_delete,
+        ask_preroll
     };
 
     AudioVideoMedia (MediaManager *manager, Node *node);
@@ -290,6 +390,7 @@ public:
     MediaManager::MediaType type () const override { return MediaManager::AudioVideo; }
 
     bool play () override;
+    void preroll ();
     virtual bool grabPicture (const QString &file, int frame);
     void stop () override;
     void pause () override;
@@ -321,6 +422,10 @@ protected:
  * MediaObject for (animated)images
  */
 
+#ifdef KMPLAYER_WITH_CAIRO
+struct ImageScaled;
+#endif
+
 struct ImageData
 {
     enum ImageFlags {
@@ -331,6 +436,7 @@ struct ImageData
     void setImage (QImage *img);
 #ifdef KMPLAYER_WITH_CAIRO
     void copyImage (Surface *s, const SSize &sz, cairo_surface_t *similar, CalculatedSizer *zoom=nullptr);
+    void clearScaled ();
 #endif
     bool isEmpty () const {
         return !image
@@ -345,9 +451,14 @@ struct ImageData
     short flags;
     bool has_alpha;
 private:
+#ifdef KMPLAYER_WITH_CAIRO
+    cairo_surface_t *scaledSurface (cairo_surface_t *similar, int w, int h);
+    static void dropScaled (ImageScaled *e);
+#endif
     QImage *image;
 #ifdef KMPLAYER_WITH_CAIRO
     cairo_surface_t *surface;
+    ImageScaled *scaled;  // pre-scaled copies of surface, shared by all users
 #endif
     QString url;
 };
@@ -355,6 +466,26 @@ private:
 typedef SharedPtr <ImageData> ImageDataPtr;
 typedef WeakPtr <ImageData> ImageDataPtrW;
 
+/*
+ * Decodes image data on a QThreadPool thread. Deletes itself after
+ * delivering the result, unless taken from the pool before it ran.
+ */
+class ImageDecodeJob : public QObject, public QRunnable
+{
+    Q_OBJECT
+public:
+    ImageDecodeJob (const QByteArray &data, const QString &url);
+
+    void run () override;
+
+Q_SIGNALS:
+    void decoded (const QImage &image, bool animated, const QString &url);
+
+private:
+    QByteArray data;
+    QString url;
+};
+
 class ImageMedia : public MediaObject
 {
     Q_OBJECT
@@ -372,6 +503,7 @@ public:
 
     bool wget (const QString &url);
     bool isEmpty () const;
+    bool decoding () const { return !decode_job.isNull (); }
     void render (const ISize &size);
     void sizes (SSize &size);
     void updateRender ();
@@ -379,6 +511,7 @@ public:
     ImageDataPtr cached_img;
 
 private Q_SLOTS:
+    void imageDecoded (const QImage &image, bool animated, const QString &url);
     void svgUpdated();
     void movieUpdated (const QRect &);
     void movieStatus (QMovie::MovieState);
@@ -394,9 +527,11 @@ private:
     QBuffer *buffer;
     QMovie *img_movie;
     QSvgRenderer *svg_renderer;
+    QPointer <ImageDecodeJob> decode_job;
     int frame_nr;
     bool update_render;
     bool paused;
+    bool play_pending;   // play () called while still decoding
 };
 
 //------------------------%<----------------------------------------------------
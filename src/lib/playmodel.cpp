@@ -149,6 +149,7 @@ bool PlayModel::setData (const QModelIndex& i, const QVariant& v, int role)
         PlayItem *pi = item->parent ();
         if (pi && pi->node) {
             pi->node->document ()->m_tree_version++;
+            pi->node->document ()->invalidateIndex ();
             pi->node->closed ();
         }
         changed = true;
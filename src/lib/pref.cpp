@@ -230,11 +230,14 @@ PrefGeneralPageGeneral::PrefGeneralPageGeneral(QWidget *parent, Settings *)
     adjustvolume->setWhatsThis(i18n ("When a new source is selected, the volume will be set according the volume control"));
     adjustcolors = new QCheckBox(i18n("Auto set colors on start"));
     adjustcolors->setWhatsThis(i18n ("When a movie starts, the colors will be set according the sliders for colors"));
+    prestartBackend = new QCheckBox(i18n("Start player backend in advance"));
+    prestartBackend->setWhatsThis(i18n ("When checked, the player backend is started in the background, so that the first movie starts faster"));
     vbox = new QVBoxLayout;
     vbox->addWidget(loop);
     vbox->addWidget(framedrop);
     vbox->addWidget(adjustvolume);
     vbox->addWidget(adjustcolors);
+    vbox->addWidget(prestartBackend);
     playbox->setLayout(vbox);
 
     QGroupBox* controlbox = new QGroupBox(i18n("Control Panel"));
@@ -107,6 +107,7 @@ public:
     QCheckBox *framedrop;
     QCheckBox *adjustvolume;
     QCheckBox *adjustcolors;
+    QCheckBox *prestartBackend;
 
     QSpinBox *seekTime;
 };
@@ -0,0 +1,97 @@
+/*
+    This file belong to the KMPlayer project, a movie player plugin for Konqueror
+    SPDX-FileCopyrightText: 2026 The KMPlayer authors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef _KMPLAYER_SHARED_FRAMES_H_
+#define _KMPLAYER_SHARED_FRAMES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+namespace KMPlayer {
+
+/*
+ * Header of a memfd shared between a backend agent (the writer) and the
+ * player (the reader), followed by 'slots' ARGB32 premultiplied frames of
+ * 'stride' * 'height' bytes each. The writer never touches the slot last
+ * published nor the one the reader has locked, so neither side ever waits.
+ */
+struct SharedFrames {
+    enum { Magic = 0x4b4d5046, MaxSlots = 4, HeaderSize = 64 };
+
+    uint32_t magic;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    uint32_t slots;
+    std::atomic <uint32_t> latest;  /* last published slot, or MaxSlots */
+    std::atomic <uint32_t> reading; /* slot locked by reader, or MaxSlots */
+
+    static size_t size (uint32_t stride, uint32_t height, uint32_t slots) {
+        return HeaderSize + (size_t) stride * height * slots;
+    }
+    unsigned char *data (uint32_t slot) {
+        return (unsigned char *) this + HeaderSize + (size_t) stride * height * slot;
+    }
+    void init (uint32_t w, uint32_t h, uint32_t s, uint32_t n) {
+        width = w;
+        height = h;
+        stride = s;
+        slots = n;
+        latest.store (MaxSlots);
+        reading.store (MaxSlots);
+        magic = Magic;
+    }
+    bool valid (size_t len) const {
+        return len >= HeaderSize && magic == Magic &&
+            slots > 2 && slots <= MaxSlots &&
+            stride >= width * 4 && len >= size (stride, height, slots);
+    }
+
+    /* writer */
+    uint32_t writeSlot () const {
+        uint32_t l = latest.load ();
+        uint32_t r = reading.load ();
+        for (uint32_t i = 0; i < slots; ++i)
+            if (i != l && i != r)
+                return i;
+        return 0; // not reached with slots > 2
+    }
+    void publish (uint32_t slot) {
+        /* seq_cst, like the loads in writeSlot and the stores in lock, so
+         * that a reader storing 'reading' and then seeing 'latest' unchanged
+         * is also seen by the writer's next writeSlot */
+        latest.store (slot);
+    }
+
+    /* reader, returns MaxSlots when nothing is published yet */
+    uint32_t lock () {
+        uint32_t l = latest.load ();
+        while (l < slots) {
+            reading.store (l);
+            uint32_t again = latest.load ();
+            if (again == l)
+                break;
+            l = again;
+        }
+        if (l >= slots) {
+            reading.store (MaxSlots);
+            return MaxSlots;
+        }
+        return l;
+    }
+    void unlock () {
+        reading.store (MaxSlots, std::memory_order_release);
+    }
+};
+
+static_assert (sizeof (SharedFrames) <= SharedFrames::HeaderSize,
+        "SharedFrames header too large");
+
+} // namespace
+
+#endif
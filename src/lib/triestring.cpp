@@ -15,6 +15,9 @@
 #include <cstdlib>
 #include <vector>
 
+#include <QAtomicInt>
+#include <QReadWriteLock>
+
 #include "kmplayercommon_log.h"
 #include "triestring.h"
 
@@ -54,7 +57,7 @@ struct TrieNode
             free(old);
     }
 
-    int ref_count;
+    QAtomicInt ref_count;
     unsigned length;
     TrieNode* parent;
     std::vector<TrieNode*> children;
@@ -91,12 +94,23 @@ static char* trieRetrieveString (TrieNode* node, int& len)
 
 static TrieNode* trieRoot()
 {
-    static TrieNode* trie_root;
-    if (!trie_root)
-        trie_root = new TrieNode();
+    static TrieNode* trie_root = new TrieNode();
     return trie_root;
 }
 
+/**
+ * Guards the trie layout, ie. children, parent and the node strings.
+ * Reference counts are atomic and only need the lock when going to or
+ * from zero, so copying and destroying interned strings stays lock free.
+ * Never deleted, like the root, as static TrieStrings are destroyed after
+ * a function local static lock would be.
+ */
+static QReadWriteLock* trieLock()
+{
+    static QReadWriteLock* trie_lock = new QReadWriteLock();
+    return trie_lock;
+}
+
 static void dump(TrieNode* n, int indent)
 {
     for (int i =0; i < indent; ++i)
@@ -249,6 +263,26 @@ static TrieNode* trieInsert(TrieNode* parent, const char* s, size_t len)
     return node;
 }
 
+// same search as trieInsert, but without modifying the trie
+static TrieNode* trieFind(TrieNode* parent, const char* s, size_t len)
+{
+    if (!*s)
+        return parent;
+
+    unsigned idx = trieLowerBound(parent, 0, parent->children.size(), s[0]);
+    if (idx < parent->children.size()) {
+        TrieNode* node = parent->children[idx];
+        char* s2 = trieCharPtr(node);
+        if (s[0] == s2[0]) {
+            if (node->length == len && !memcmp((void*)s, s2, len))
+                return node;
+            if (node->length < len && !memcmp((void*)s, s2, node->length))
+                return trieFind(node, s + node->length, len - node->length);
+        }
+    }
+    return nullptr;
+}
+
 static void trieRemove(TrieNode* node)
 {
     if (node->children.size() > 1)
@@ -272,11 +306,47 @@ static void trieRemove(TrieNode* node)
     } else {
         parent->children.erase(parent->children.begin() + idx);
         delete node;
-        if (!parent->ref_count)
+        if (!parent->ref_count.loadRelaxed())
             trieRemove(parent);
     }
 }
 
+static TrieNode* trieIntern(const char* s, size_t len)
+{
+    TrieNode* node;
+    {
+        // most strings are already in the trie, try a shared lock first
+        QReadLocker locker(trieLock());
+        node = trieFind(trieRoot(), s, len);
+        if (node) {
+            node->ref_count.ref();
+            return node;
+        }
+    }
+    QWriteLocker locker(trieLock());
+    node = trieInsert(trieRoot(), s, len);
+    node->ref_count.ref();
+    return node;
+}
+
+static void trieRelease(TrieNode* node)
+{
+    for (int c = node->ref_count.loadAcquire(); c > 1; c = node->ref_count.loadAcquire())
+        if (node->ref_count.testAndSetOrdered(c, c - 1))
+            return;
+    // possibly the last reference, trieIntern can't revive it meanwhile
+    QWriteLocker locker(trieLock());
+    if (!node->ref_count.deref()) {
+#ifdef TEST_TRIE
+        int len = 0;
+        char* buf = trieRetrieveString(node, len);
+        fprintf(stderr, "delete %s\n", buf);
+        free(buf);
+#endif
+        trieRemove(node);
+    }
+}
+
 static int trieStringStarts(TrieNode* node, const char* s, int& pos)
 {
     int cmp = -1; // -1 still matches, 0 no, 1 yes
@@ -296,52 +366,37 @@ TrieString::TrieString (const QString& s) : node(nullptr)
 {
     if (!s.isNull()) {
         const QByteArray ba = s.toUtf8();
-        node = trieInsert(trieRoot(), ba.constData(), ba.length());
-        ++node->ref_count;
+        node = trieIntern(ba.constData(), ba.length());
     }
 }
 
 TrieString::TrieString(const char* s)
-    : node(!s ? nullptr : trieInsert(trieRoot(), s, strlen(s)))
+    : node(!s ? nullptr : trieIntern(s, strlen(s)))
 {
-    if (node)
-        ++node->ref_count;
 }
 
 TrieString::TrieString(const char* s, int len)
-    : node(!s ? nullptr : trieInsert(trieRoot(), s, len))
+    : node(!s ? nullptr : trieIntern(s, len))
 {
-    if (node)
-        ++node->ref_count;
 }
 
 TrieString::TrieString(const TrieString& s) : node(s.node)
 {
     if (node)
-        ++node->ref_count;
+        node->ref_count.ref();
 }
 
 TrieString::~TrieString()
 {
-    if (node && !--node->ref_count) {
-#ifdef TEST_TRIE
-        fprintf(stderr, "delete %s\n", qPrintable(toString()));
-#endif
-        trieRemove(node);
-    }
+    if (node)
+        trieRelease(node);
 }
 
 TrieString& TrieString::operator=(const char* s)
 {
-    if (node && !--node->ref_count) {
-#ifdef TEST_TRIE
-        fprintf(stderr, "= delete %s\n", qPrintable(toString()));
-#endif
-        trieRemove(node);
-    }
-    node = !s ? nullptr : trieInsert(trieRoot(), s, strlen(s));
     if (node)
-        ++node->ref_count;
+        trieRelease(node);
+    node = !s ? nullptr : trieIntern(s, strlen(s));
     return *this;
 }
 
@@ -349,13 +404,9 @@ TrieString& TrieString::operator=(const TrieString& s)
 {
     if (s.node != node) {
         if (s.node)
-            ++s.node->ref_count;
-        if (node && !--node->ref_count) {
-#ifdef TEST_TRIE
-            fprintf(stderr, "= delete %s\n", qPrintable(toString()));
-#endif
-            trieRemove(node);
-        }
+            s.node->ref_count.ref();
+        if (node)
+            trieRelease(node);
         node = s.node;
     }
     return *this;
@@ -363,16 +414,21 @@ TrieString& TrieString::operator=(const TrieString& s)
 
 bool TrieString::operator<(const TrieString& s) const
 {
+    if (node == s.node)
+        return false;
+    QReadLocker locker(trieLock());
     return trieCompare(node, s.node) < 0;
 }
 
 bool KMPlayer::operator==(const TrieString& t, const char* s)
 {
+    QReadLocker locker(trieLock());
     return trieStringCompare(t.node, s) == 0;
 }
 
 bool TrieString::startsWith(const TrieString& s) const
 {
+    QReadLocker locker(trieLock());
     for (TrieNode* n = node; n; n = n->parent)
         if (n == s.node)
             return true;
@@ -385,6 +441,7 @@ bool TrieString::startsWith(const char* str) const
         return !str ? true : false;
     if (!str)
         return true;
+    QReadLocker locker(trieLock());
     int pos = 0;
     return trieStringStarts(node, str, pos) != 0;
 }
@@ -394,7 +451,11 @@ QString TrieString::toString() const
     if (!node)
         return QString();
     int len = 0;
-    char* buf = trieRetrieveString(node, len);
+    char* buf;
+    {
+        QReadLocker locker(trieLock());
+        buf = trieRetrieveString(node, len);
+    }
     QString s = QString::fromUtf8(buf);
     free(buf);
     return s;
@@ -402,12 +463,8 @@ QString TrieString::toString() const
 
 void TrieString::clear()
 {
-    if (node && !--node->ref_count) {
-#ifdef TEST_TRIE
-        fprintf(stderr, "clear delete %s\n", qPrintable(toString()));
-#endif
-        trieRemove(node);
-    }
+    if (node)
+        trieRelease(node);
     node = nullptr;
 }
 
@@ -433,29 +490,69 @@ TrieString Ids::attr_type;
 TrieString Ids::attr_value;
 TrieString Ids::attr_fill;
 TrieString Ids::attr_fit;
+TrieString Ids::attr_endsync;
+TrieString Ids::attr_repeat;
+TrieString Ids::attr_expr;
+TrieString Ids::attr_pan_zoom;
+TrieString Ids::attr_background_color;
+TrieString Ids::attr_background_color_smil1;
+TrieString Ids::attr_background_opacity;
+TrieString Ids::attr_background_image;
+TrieString Ids::attr_background_repeat;
+TrieString Ids::attr_show_background;
+TrieString Ids::attr_media_opacity;
+TrieString Ids::attr_media_background_opacity;
+TrieString Ids::attr_system_bitrate;
+TrieString Ids::attr_trans_in;
+TrieString Ids::attr_trans_out;
+TrieString Ids::attr_sensitivity;
+TrieString Ids::attr_reg_point;
+TrieString Ids::attr_reg_align;
+TrieString Ids::attr_media_align;
+TrieString Ids::attr_z_index;
 
 void Ids::init() {
+    attr_z_index = "z-index";
     attr_width = "width";
     attr_value = "value";
     attr_url = "url";
     attr_type = "type";
+    attr_trans_out = "transOut";
+    attr_trans_in = "transIn";
     attr_top = "top";
     attr_title = "title";
     attr_target = "target";
+    attr_system_bitrate = "system-bitrate";
     attr_src = "src";
+    attr_show_background = "showBackground";
+    attr_sensitivity = "sensitivity";
     attr_right = "right";
+    attr_repeat = "repeat";
     attr_region = "region";
+    attr_reg_point = "regPoint";
+    attr_reg_align = "regAlign";
+    attr_pan_zoom = "panZoom";
     attr_name = "name";
+    attr_media_opacity = "mediaOpacity";
+    attr_media_background_opacity = "mediaBackgroundOpacity";
+    attr_media_align = "mediaAlign";
     attr_left = "left";
     attr_id = "id";
     attr_href = "href";
     attr_height = "height";
     attr_fit = "fit";
     attr_fill = "fill";
+    attr_expr = "expr";
+    attr_endsync = "endsync";
     attr_end = "end";
     attr_dur = "dur";
     attr_bottom = "bottom";
     attr_begin = "begin";
+    attr_background_repeat = "backgroundRepeat";
+    attr_background_opacity = "backgroundOpacity";
+    attr_background_image = "backgroundImage";
+    attr_background_color = "backgroundColor";
+    attr_background_color_smil1 = "background-color";
 }
 
 void Ids::reset() {
@@ -480,9 +577,30 @@ void Ids::reset() {
     attr_value.clear ();
     attr_fill.clear ();
     attr_fit.clear ();
+    attr_endsync.clear ();
+    attr_repeat.clear ();
+    attr_expr.clear ();
+    attr_pan_zoom.clear ();
+    attr_background_color.clear ();
+    attr_background_color_smil1.clear ();
+    attr_background_opacity.clear ();
+    attr_background_image.clear ();
+    attr_background_repeat.clear ();
+    attr_show_background.clear ();
+    attr_media_opacity.clear ();
+    attr_media_background_opacity.clear ();
+    attr_system_bitrate.clear ();
+    attr_trans_in.clear ();
+    attr_trans_out.clear ();
+    attr_sensitivity.clear ();
+    attr_reg_point.clear ();
+    attr_reg_align.clear ();
+    attr_media_align.clear ();
+    attr_z_index.clear ();
+    QReadLocker locker(trieLock());
     if (trieRoot()->children.size()) {
         qCWarning(LOG_KMPLAYER_COMMON) << "Trie not empty";
-        dumpTrie ();
+        dump(trieRoot(), 0);
     //} else {
         //delete root_trie;
         //root_trie = 0;
@@ -490,6 +608,7 @@ void Ids::reset() {
 }
 
 void KMPlayer::dumpTrie () {
+    QReadLocker locker(trieLock());
     dump(trieRoot(), 0);
 }
 
@@ -11,6 +11,7 @@
 #include "kmplayercommon_export.h"
 
 #include <QString>
+#include <QHash>
 
 namespace KMPlayer {
 
@@ -23,6 +24,7 @@ class KMPLAYERCOMMON_EXPORT TrieString
     friend bool operator == (const TrieString & s, const char * utf8);
     friend bool operator == (const char * utf8, const TrieString & s);
     friend bool operator != (const TrieString & s1, const TrieString & s2);
+    friend uint qHash (const TrieString & s, uint seed);
 public:
     TrieString ();
     TrieString (const QString & s);
@@ -70,6 +72,26 @@ public:
     static TrieString attr_value;
     static TrieString attr_fill;
     static TrieString attr_fit;
+    static TrieString attr_endsync;
+    static TrieString attr_repeat;
+    static TrieString attr_expr;
+    static TrieString attr_pan_zoom;
+    static TrieString attr_background_color;
+    static TrieString attr_background_color_smil1;
+    static TrieString attr_background_opacity;
+    static TrieString attr_background_image;
+    static TrieString attr_background_repeat;
+    static TrieString attr_show_background;
+    static TrieString attr_media_opacity;
+    static TrieString attr_media_background_opacity;
+    static TrieString attr_system_bitrate;
+    static TrieString attr_trans_in;
+    static TrieString attr_trans_out;
+    static TrieString attr_sensitivity;
+    static TrieString attr_reg_point;
+    static TrieString attr_reg_align;
+    static TrieString attr_media_align;
+    static TrieString attr_z_index;
 };
 
 inline bool TrieString::isNull () const {
@@ -90,6 +112,10 @@ inline bool operator != (const TrieString & s1, const TrieString & s2) {
     return s1.node != s2.node;
 }
 
+inline uint qHash (const TrieString & s, uint seed = 0) {
+    return QT_PREPEND_NAMESPACE(qHash) ((quintptr) s.node, seed);
+}
+
 void dumpTrie ();
 
 } // namespace
@@ -13,6 +13,10 @@
 #include <QApplication>
 #include <QSlider>
 #include <QCursor>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QCache>
+#include <QHash>
 #include <QMap>
 #include <QPalette>
 #include <QDesktopWidget>
@@ -39,6 +43,7 @@
 # include <cairo-xcb.h>
 #endif
 #include "mediaobject.h"
+#include "sharedframes.h"
 #include "kmplayer_smil.h"
 #include "kmplayer_rp.h"
 #include "mediaobject.h"
@@ -60,6 +65,124 @@ static void clearSurface (cairo_t *cr, const IRect &rect) {
     cairo_restore (cr);
 }
 
+namespace {
+
+/* a cairo surface owned by one of the QCache's below */
+struct CachedSurface {
+    CachedSurface (cairo_surface_t *sf) : surface (sf) {}
+    ~CachedSurface () {
+        cairo_surface_destroy (surface);
+    }
+    cairo_surface_t *surface;
+};
+
+}
+
+/*
+ * Scaled copies of static images, so that a region animating its size
+ * or several regions showing the same image at the same size don't
+ * rescale the bitmap on every paint. All ImageData share one LRU list
+ * and a byte budget.
+ */
+namespace KMPlayer {
+
+struct ImageScaled {
+    ImageScaled (ImageData *o, cairo_surface_t *sf, int w, int h)
+     : owner (o), surface (sf), width (w), height (h), bytes (4 * w * h),
+       next_sibling (nullptr), lru_prev (nullptr), lru_next (nullptr) {}
+    ~ImageScaled () {
+        cairo_surface_destroy (surface);
+    }
+    ImageData *owner;
+    cairo_surface_t *surface;
+    int width;
+    int height;
+    int bytes;
+    ImageScaled *next_sibling;   // other sizes of the same image
+    ImageScaled *lru_prev;
+    ImageScaled *lru_next;
+};
+
+}
+
+static ImageScaled *scaled_lru_first;
+static ImageScaled *scaled_lru_last;
+static int scaled_cache_size;
+static const int scaled_cache_max = 64 * 1024 * 1024;
+
+static void scaledUnlink (ImageScaled *e) {
+    if (e->lru_prev)
+        e->lru_prev->lru_next = e->lru_next;
+    else
+        scaled_lru_first = e->lru_next;
+    if (e->lru_next)
+        e->lru_next->lru_prev = e->lru_prev;
+    else
+        scaled_lru_last = e->lru_prev;
+    e->lru_prev = e->lru_next = nullptr;
+}
+
+static void scaledLinkFirst (ImageScaled *e) {
+    e->lru_prev = nullptr;
+    e->lru_next = scaled_lru_first;
+    if (scaled_lru_first)
+        scaled_lru_first->lru_prev = e;
+    else
+        scaled_lru_last = e;
+    scaled_lru_first = e;
+}
+
+void ImageData::dropScaled (ImageScaled *e) {
+    ImageScaled **pe = &e->owner->scaled;
+    while (*pe != e)
+        pe = &(*pe)->next_sibling;
+    *pe = e->next_sibling;
+    scaledUnlink (e);
+    scaled_cache_size -= e->bytes;
+    delete e;
+}
+
+void ImageData::clearScaled () {
+    while (scaled)
+        dropScaled (scaled);
+}
+
+cairo_surface_t *ImageData::scaledSurface (cairo_surface_t *similar, int w, int h) {
+    for (ImageScaled *e = scaled; e; e = e->next_sibling)
+        if (e->width == w && e->height == h) {
+            if (e != scaled_lru_first) {
+                scaledUnlink (e);
+                scaledLinkFirst (e);
+            }
+            return e->surface;
+        }
+    if (w <= 0 || h <= 0 || 4 * (qint64) w * h > scaled_cache_max / 4)
+        return nullptr;
+
+    cairo_surface_t *sf = cairo_surface_create_similar (similar,
+            has_alpha ? CAIRO_CONTENT_COLOR_ALPHA : CAIRO_CONTENT_COLOR, w, h);
+    cairo_pattern_t *pat = cairo_pattern_create_for_surface (surface);
+    cairo_pattern_set_extend (pat, CAIRO_EXTEND_NONE);
+    cairo_matrix_t mat;
+    cairo_matrix_init_scale (&mat, 1.0 * width/w, 1.0 * height/h);
+    cairo_pattern_set_matrix (pat, &mat);
+    cairo_t *cr = cairo_create (sf);
+    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source (cr, pat);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+    cairo_pattern_destroy (pat);
+
+    ImageScaled *e = new ImageScaled (this, sf, w, h);
+    e->next_sibling = scaled;
+    scaled = e;
+    scaledLinkFirst (e);
+    scaled_cache_size += e->bytes;
+    while (scaled_cache_size > scaled_cache_max && scaled_lru_last != e)
+        dropScaled (scaled_lru_last);
+    return sf;
+}
+
 void ImageData::copyImage (Surface *s, const SSize &sz, cairo_surface_t *similar, CalculatedSizer *zoom) {
     cairo_surface_t *src_sf;
     bool clear = false;
@@ -96,6 +219,21 @@ void ImageData::copyImage (Surface *s, const SSize &sz, cairo_surface_t *similar
         }
     }
 
+    if (!zoom && src_sf == surface) {
+        // static image, let the surface share the (scaled) pixels
+        cairo_surface_t *sf = w == width && h == height
+            ? surface
+            : scaledSurface (similar, w, h);
+        if (sf) {
+            if (s->surface != sf) {
+                if (s->surface)
+                    cairo_surface_destroy (s->surface);
+                s->surface = cairo_surface_reference (sf);
+            }
+            return;
+        }
+    }
+
     cairo_pattern_t *img_pat = cairo_pattern_create_for_surface (src_sf);
     cairo_pattern_set_extend (img_pat, CAIRO_EXTEND_NONE);
     if (zoom) {
@@ -110,6 +248,11 @@ void ImageData::copyImage (Surface *s, const SSize &sz, cairo_surface_t *similar
         cairo_matrix_init_scale (&mat, 1.0 * width/w, 1.0 * height/h);
         cairo_pattern_set_matrix (img_pat, &mat);
     }
+    if (s->surface && cairo_surface_get_reference_count (s->surface) > 1) {
+        // shares the pixels of surface or of a scaled copy, don't draw in it
+        cairo_surface_destroy (s->surface);
+        s->surface = nullptr;
+    }
     if (!s->surface)
         s->surface = cairo_surface_create_similar (similar,
                 has_alpha ?
@@ -172,6 +315,7 @@ class CairoPaintVisitor : public Visitor, public PaintContext
     TransitionModule *cur_transition;
     cairo_pattern_t * cur_pat;
     cairo_matrix_t cur_mat;
+    cairo_pattern_t *cur_mask;
     float opacity;
     bool toplevel;
 
@@ -179,7 +323,11 @@ class CairoPaintVisitor : public Visitor, public PaintContext
     void updateExternal (SMIL::MediaType *av, SurfacePtr s);
     void paint (TransitionModule *trans, MediaOpacity mopacity, Surface *s,
                 const IPoint &p, const IRect &);
+    void paint (TransitionModule *trans, MediaOpacity mopacity,
+                cairo_surface_t *src, const cairo_matrix_t &mat, const IRect &);
     void video (Mrl *mt, Surface *s);
+    void fillPath (float alpha);
+    bool videoFrame (SMIL::RefMediaType *ref, Surface *s);
 public:
     cairo_t * cr;
     CairoPaintVisitor (cairo_surface_t * cs, Matrix m,
@@ -206,7 +354,7 @@ public:
 
 CairoPaintVisitor::CairoPaintVisitor (cairo_surface_t * cs, Matrix m,
         const IRect & rect, QColor c, bool top)
- : PaintContext (m, rect), cairo_surface (cs), toplevel (top)
+ : PaintContext (m, rect), cairo_surface (cs), cur_mask (nullptr), toplevel (top)
 {
     cr = cairo_create (cs);
     if (toplevel) {
@@ -463,79 +611,22 @@ void CairoPaintVisitor::visit (SMIL::RegionBase *reg) {
         cairo_set_source (cr, pat);                             \
     }
 
-void CairoPaintVisitor::visit (SMIL::Transition *trans) {
-    float perc = trans->start_progress + (trans->end_progress - trans->start_progress)*cur_transition->trans_gain;
-    if (cur_transition->trans_out_active)
-        perc = 1.0 - perc;
-    if (SMIL::Transition::Fade == trans->type) {
-        CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
-        cairo_rectangle (cr, clip.x(), clip.y(), clip.width(), clip.height());
-        opacity = perc;
-    } else if (SMIL::Transition::BarWipe == trans->type) {
-        IRect rect;
-        if (SMIL::Transition::SubTopToBottom == trans->sub_type) {
-            if (SMIL::Transition::dir_reverse == trans->direction) {
-                int dy = (int) ((1.0 - perc) * clip.height ());
-                rect = IRect (clip.x (), clip.y () + dy,
-                        clip.width (), clip.height () - dy);
-            } else {
-                rect = IRect (clip.x (), clip.y (),
-                        clip.width (), (int) (perc * clip.height ()));
-            }
-        } else {
-            if (SMIL::Transition::dir_reverse == trans->direction) {
-                int dx = (int) ((1.0 - perc) * clip.width ());
-                rect = IRect (clip.x () + dx, clip.y (),
-                        clip.width () - dx, clip.height ());
-            } else {
-                rect = IRect (clip.x (), clip.y (),
-                        (int) (perc * clip.width ()), clip.height ());
-            }
-        }
-        cairo_rectangle (cr, rect.x(), rect.y(), rect.width(), rect.height());
-        CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
-    } else if (SMIL::Transition::PushWipe == trans->type) {
-        int dx = 0, dy = 0;
-        if (SMIL::Transition::SubFromTop == trans->sub_type)
-            dy = -(int) ((1.0 - perc) * clip.height ());
-        else if (SMIL::Transition::SubFromRight == trans->sub_type)
-            dx = (int) ((1.0 - perc) * clip.width ());
-        else if (SMIL::Transition::SubFromBottom == trans->sub_type)
-            dy = (int) ((1.0 - perc) * clip.height ());
-        else //if (SMIL::Transition::SubFromLeft == trans->sub_type)
-            dx = -(int) ((1.0 - perc) * clip.width ());
-        cairo_matrix_translate (&cur_mat, -dx, -dy);
-        IRect rect = clip.intersect (IRect (clip.x () + dx, clip.y () + dy,
-                    clip.width (), clip.height ()));
-        cairo_rectangle (cr, rect.x(), rect.y(), rect.width(), rect.height());
-        CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
-    } else if (SMIL::Transition::IrisWipe == trans->type) {
-        CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
-        if (SMIL::Transition::SubDiamond == trans->sub_type) {
-            cairo_rectangle (cr, clip.x(), clip.y(),clip.width(),clip.height());
-            cairo_clip (cr);
-            int dx = (int) (perc * clip.width ());
-            int dy = (int) (perc * clip.height ());
-            int mx = clip.x () + clip.width ()/2;
-            int my = clip.y () + clip.height ()/2;
-            cairo_new_path (cr);
-            cairo_move_to (cr, mx, my - dy);
-            cairo_line_to (cr, mx + dx, my);
-            cairo_line_to (cr, mx, my + dy);
-            cairo_line_to (cr, mx - dx, my);
-            cairo_close_path (cr);
-        } else { // SubRectangle
-            int dx = (int) (0.5 * (1 - perc) * clip.width ());
-            int dy = (int) (0.5 * (1 - perc) * clip.height ());
-            cairo_rectangle (cr, clip.x () + dx, clip.y () + dy,
-                    clip.width () - 2 * dx, clip.height () -2 * dy);
-        }
+static void wipePath (cairo_t *cr, SMIL::Transition *trans,
+        const IRect &clip, float perc) {
+    cairo_new_path (cr);
+    if (SMIL::Transition::IrisWipe == trans->type) { // SubDiamond
+        int dx = (int) (perc * clip.width ());
+        int dy = (int) (perc * clip.height ());
+        int mx = clip.x () + clip.width ()/2;
+        int my = clip.y () + clip.height ()/2;
+        cairo_move_to (cr, mx, my - dy);
+        cairo_line_to (cr, mx + dx, my);
+        cairo_line_to (cr, mx, my + dy);
+        cairo_line_to (cr, mx - dx, my);
+        cairo_close_path (cr);
     } else if (SMIL::Transition::ClockWipe == trans->type) {
-        cairo_rectangle (cr, clip.x(), clip.y(), clip.width(), clip.height());
-        cairo_clip (cr);
         int mx = clip.x () + clip.width ()/2;
         int my = clip.y () + clip.height ()/2;
-        cairo_new_path (cr);
         cairo_move_to (cr, mx, my);
         float hw = 1.0 * clip.width ()/2;
         float hh = 1.0 * clip.height ()/2;
@@ -560,13 +651,9 @@ void CairoPaintVisitor::visit (SMIL::Transition *trans) {
         else
             cairo_arc (cr, mx, my, radius, phi, phi + 2 * M_PI * perc);
         cairo_close_path (cr);
-        CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
     } else if (SMIL::Transition::BowTieWipe == trans->type) {
-        cairo_rectangle (cr, clip.x(), clip.y(), clip.width(), clip.height());
-        cairo_clip (cr);
         int mx = clip.x () + clip.width ()/2;
         int my = clip.y () + clip.height ()/2;
-        cairo_new_path (cr);
         cairo_move_to (cr, mx, my);
         float hw = 1.0 * clip.width ()/2;
         float hh = 1.0 * clip.height ()/2;
@@ -590,17 +677,13 @@ void CairoPaintVisitor::visit (SMIL::Transition *trans) {
         else
             cairo_arc (cr, mx, my, radius, -phi - dphi, -phi + dphi);
         cairo_close_path (cr);
-        CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
-    } else if (SMIL::Transition::EllipseWipe == trans->type) {
-        cairo_rectangle (cr, clip.x(), clip.y(), clip.width(), clip.height());
-        cairo_clip (cr);
+    } else { // EllipseWipe
         int mx = clip.x () + clip.width ()/2;
         int my = clip.y () + clip.height ()/2;
         float hw = (double) clip.width ()/2;
         float hh = (double) clip.height ()/2;
         float radius = sqrtf (hw * hw + hh * hh);
         cairo_save (cr);
-        cairo_new_path (cr);
         cairo_translate (cr, (int) mx, (int) my);
         cairo_move_to (cr, - Single (radius), 0);
         if (SMIL::Transition::SubHorizontal == trans->sub_type)
@@ -610,7 +693,115 @@ void CairoPaintVisitor::visit (SMIL::Transition *trans) {
         cairo_arc (cr, 0, 0, perc * radius, 0, 2 * M_PI);
         cairo_close_path (cr);
         cairo_restore (cr);
+    }
+}
+
+/*
+ * Antialiased masks of the curved wipes, per type, sub type, direction,
+ * size and progress quantized to transition_mask_steps. Looping signage
+ * and regions running the same transition side by side reuse them
+ * instead of rasterizing the arcs again. Only sizes of which all the steps
+ * of a transition fit in the cache are cached, larger ones would evict
+ * their own earlier steps before a loop comes back to them, so these use
+ * wipePath directly.
+ */
+static const int transition_mask_steps = 128;
+static const int transition_mask_cache_max = 64 * 1024 * 1024;
+
+static cairo_pattern_t *wipeMask (SMIL::Transition *trans,
+        const IRect &clip, float perc) {
+    static QCache <quint64, CachedSurface> cache (transition_mask_cache_max);
+    int w = clip.width ();
+    int h = clip.height ();
+    int cost = cairo_format_stride_for_width (CAIRO_FORMAT_A8, w) * h;
+    if (w <= 0 || h <= 0 || w > 0xffff || h > 0xffff ||
+            (qint64) cost * (transition_mask_steps + 1) > transition_mask_cache_max)
+        return nullptr;
+    int step = (int) (qBound (0.0f, perc, 1.0f) * transition_mask_steps + 0.5);
+    quint64 key = (quint64) trans->type << 56 | (quint64) trans->sub_type << 48 |
+        (quint64) trans->direction << 40 | (quint64) step << 32 |
+        (quint64) w << 16 | h;
+    CachedSurface *mask = cache.object (key);
+    if (!mask) {
+        cairo_surface_t *sf = cairo_image_surface_create (CAIRO_FORMAT_A8, w, h);
+        cairo_t *cr = cairo_create (sf);
+        wipePath (cr, trans, IRect (0, 0, w, h), 1.0 * step / transition_mask_steps);
+        cairo_fill (cr);
+        cairo_destroy (cr);
+        mask = new CachedSurface (sf);
+        cache.insert (key, mask, cost);
+    }
+    cairo_pattern_t *pat = cairo_pattern_create_for_surface (mask->surface);
+    cairo_matrix_t mat;
+    cairo_matrix_init_translate (&mat, -clip.x (), -clip.y ());
+    cairo_pattern_set_matrix (pat, &mat);
+    return pat;
+}
+
+void CairoPaintVisitor::visit (SMIL::Transition *trans) {
+    float perc = trans->start_progress + (trans->end_progress - trans->start_progress)*cur_transition->trans_gain;
+    if (cur_transition->trans_out_active)
+        perc = 1.0 - perc;
+    if (SMIL::Transition::Fade == trans->type) {
+        CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
+        cairo_rectangle (cr, clip.x(), clip.y(), clip.width(), clip.height());
+        opacity = perc;
+    } else if (SMIL::Transition::BarWipe == trans->type) {
+        IRect rect;
+        if (SMIL::Transition::SubTopToBottom == trans->sub_type) {
+            if (SMIL::Transition::dir_reverse == trans->direction) {
+                int dy = (int) ((1.0 - perc) * clip.height ());
+                rect = IRect (clip.x (), clip.y () + dy,
+                        clip.width (), clip.height () - dy);
+            } else {
+                rect = IRect (clip.x (), clip.y (),
+                        clip.width (), (int) (perc * clip.height ()));
+            }
+        } else {
+            if (SMIL::Transition::dir_reverse == trans->direction) {
+                int dx = (int) ((1.0 - perc) * clip.width ());
+                rect = IRect (clip.x () + dx, clip.y (),
+                        clip.width () - dx, clip.height ());
+            } else {
+                rect = IRect (clip.x (), clip.y (),
+                        (int) (perc * clip.width ()), clip.height ());
+            }
+        }
+        cairo_rectangle (cr, rect.x(), rect.y(), rect.width(), rect.height());
+        CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
+    } else if (SMIL::Transition::PushWipe == trans->type) {
+        int dx = 0, dy = 0;
+        if (SMIL::Transition::SubFromTop == trans->sub_type)
+            dy = -(int) ((1.0 - perc) * clip.height ());
+        else if (SMIL::Transition::SubFromRight == trans->sub_type)
+            dx = (int) ((1.0 - perc) * clip.width ());
+        else if (SMIL::Transition::SubFromBottom == trans->sub_type)
+            dy = (int) ((1.0 - perc) * clip.height ());
+        else //if (SMIL::Transition::SubFromLeft == trans->sub_type)
+            dx = -(int) ((1.0 - perc) * clip.width ());
+        cairo_matrix_translate (&cur_mat, -dx, -dy);
+        IRect rect = clip.intersect (IRect (clip.x () + dx, clip.y () + dy,
+                    clip.width (), clip.height ()));
+        cairo_rectangle (cr, rect.x(), rect.y(), rect.width(), rect.height());
+        CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
+    } else if (SMIL::Transition::IrisWipe == trans->type &&
+            SMIL::Transition::SubDiamond != trans->sub_type) {
         CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
+        int dx = (int) (0.5 * (1 - perc) * clip.width ());
+        int dy = (int) (0.5 * (1 - perc) * clip.height ());
+        cairo_rectangle (cr, clip.x () + dx, clip.y () + dy,
+                clip.width () - 2 * dx, clip.height () -2 * dy);
+    } else if (SMIL::Transition::IrisWipe == trans->type ||
+            SMIL::Transition::ClockWipe == trans->type ||
+            SMIL::Transition::BowTieWipe == trans->type ||
+            SMIL::Transition::EllipseWipe == trans->type) {
+        CAIRO_SET_PATTERN_COND(cr, cur_pat, cur_mat)
+        cairo_rectangle (cr, clip.x(), clip.y(), clip.width(), clip.height());
+        cur_mask = wipeMask (trans, clip, perc);
+        if (!cur_mask) {
+            cairo_clip (cr);
+            wipePath (cr, trans, clip, perc);
+        }
     }
 }
 
@@ -670,18 +861,61 @@ void CairoPaintVisitor::visit (SMIL::RefMediaType *ref) {
             id->copyImage (s, SSize (scr.width (), scr.height ()), cairo_surface, ref->pan_zoom);
         paint (&ref->transition, ref->media_opacity, s, scr.point, clip_rect);
         s->dirty = false;
-    } else {
+    } else if (!videoFrame (ref, s)) {
         video (ref, s);
     }
 }
 
+/* composite the frames a backend exports instead of showing its viewer */
+bool CairoPaintVisitor::videoFrame (SMIL::RefMediaType *ref, Surface *s) {
+    if (!s || !ref->media_info->media ||
+            MediaManager::AudioVideo != ref->media_info->type)
+        return false;
+    AudioVideoMedia *avm = static_cast<AudioVideoMedia *> (ref->media_info->media);
+    SharedFrames *frames = avm->process ? avm->process->sharedFrames () : nullptr;
+    if (!frames || avm->process->state () <= IProcess::Ready)
+        return false;
+
+    IRect scr = matrix.toScreen (s->bounds);
+    IRect clip_rect = clip.intersect (scr);
+    if (clip_rect.isEmpty ())
+        return true;
+    uint32_t slot = frames->lock ();
+    if (slot >= SharedFrames::MaxSlots)
+        return true; // nothing published yet
+    // paint straight from the locked slot, scaled to the surface bounds;
+    // RGB24 as the alpha of the frames isn't used
+    cairo_surface_t *img = cairo_image_surface_create_for_data (
+            frames->data (slot), CAIRO_FORMAT_RGB24,
+            frames->width, frames->height, frames->stride);
+    cairo_matrix_t mat;
+    cairo_matrix_init_scale (&mat, 1.0 * frames->width / scr.width (),
+            1.0 * frames->height / scr.height ());
+    cairo_matrix_translate (&mat, -scr.x (), -scr.y ());
+    paint (&ref->transition, ref->media_opacity, img, mat, clip_rect);
+    cairo_surface_finish (img); // done with the slot data
+    cairo_surface_destroy (img);
+    frames->unlock ();
+    s->dirty = false;
+    return true;
+}
+
 void CairoPaintVisitor::paint (TransitionModule *trans,
         MediaOpacity mopacity, Surface *s,
         const IPoint &point, const IRect &rect) {
+    cairo_matrix_t mat;
+    cairo_matrix_init_translate (&mat, -point.x, -point.y);
+    paint (trans, mopacity, s->surface, mat, rect);
+}
+
+/* paint src, mat maps the device to src space, clipped to rect */
+void CairoPaintVisitor::paint (TransitionModule *trans,
+        MediaOpacity mopacity, cairo_surface_t *src,
+        const cairo_matrix_t &mat, const IRect &rect) {
     cairo_save (cr);
     opacity = 1.0;
-    cairo_matrix_init_translate (&cur_mat, -point.x, -point.y);
-    cur_pat = cairo_pattern_create_for_surface (s->surface);
+    cur_mat = mat;
+    cur_pat = cairo_pattern_create_for_surface (src);
     if (trans->active_trans) {
         IRect clip_save = clip;
         clip = rect;
@@ -697,24 +931,41 @@ void CairoPaintVisitor::paint (TransitionModule *trans,
     }
     opacity *= mopacity.opacity / 100.0;
     bool over = opacity < 0.99 ||
-                CAIRO_CONTENT_COLOR != cairo_surface_get_content (s->surface);
+                CAIRO_CONTENT_COLOR != cairo_surface_get_content (src);
     cairo_operator_t op;
     if (over) {
         op = cairo_get_operator (cr);
         cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
     }
-    if (opacity < 0.99) {
-        cairo_clip (cr);
-        cairo_paint_with_alpha (cr, opacity);
-    } else {
-        cairo_fill (cr);
-    }
+    fillPath (opacity);
     if (over)
         cairo_set_operator (cr, op);
     cairo_pattern_destroy (cur_pat);
     cairo_restore (cr);
 }
 
+/* fill the current path with alpha, through the transition mask if any */
+void CairoPaintVisitor::fillPath (float alpha) {
+    if (cur_mask) {
+        cairo_clip (cr);
+        if (alpha < 0.99) {
+            cairo_push_group (cr);
+            cairo_mask (cr, cur_mask);
+            cairo_pop_group_to_source (cr);
+            cairo_paint_with_alpha (cr, alpha);
+        } else {
+            cairo_mask (cr, cur_mask);
+        }
+        cairo_pattern_destroy (cur_mask);
+        cur_mask = nullptr;
+    } else if (alpha < 0.99) {
+        cairo_clip (cr);
+        cairo_paint_with_alpha (cr, alpha);
+    } else {
+        cairo_fill (cr);
+    }
+}
+
 static Mrl *findActiveMrl (Node *n, bool *rp_or_smil) {
     Mrl *mrl = n->mrl ();
     if (mrl) {
@@ -779,10 +1030,40 @@ static void setAlignment (QTextDocument &td, unsigned char align) {
     td.setDefaultTextOption (opt);
 }
 
+/*
+ * Text layouts and rasters, keyed on everything that affects the outcome.
+ * Tickers, captions and repeated smilText flows keep showing the same
+ * strings, so both survive across frames and are shared between nodes.
+ */
+static const int text_size_cache_max = 1024;
+static const int text_image_cache_max = 8 * 1024 * 1024;
+
+/* KMPLAYER_NO_TEXT_CACHE turns the text caches off, to compare paint times */
+static bool textCacheEnabled () {
+    static const bool enabled = !qEnvironmentVariableIsSet ("KMPLAYER_NO_TEXT_CACHE");
+    return enabled;
+}
+
+static QString textCacheKey (const QFont &font, const QString &text,
+        int w, int h, int maxh, bool markup, unsigned char align) {
+    return font.key () + QChar ('\n') + text + QChar ('\n') +
+        QString::asprintf ("%d %d %d %d %d", w, h, maxh, markup, align);
+}
+
 static void calculateTextDimensions (const QFont& font,
         const QString& text, Single w, Single h, Single maxh,
         int *pxw, int *pxh, bool markup_text,
         unsigned char align = SmilTextProperties::AlignLeft) {
+    static QHash <QString, QSize> cache;
+    const QString key = textCacheKey (font, text, (int)w, (int)h, (int)maxh,
+            markup_text, align);
+    QHash <QString, QSize>::const_iterator i = textCacheEnabled ()
+        ? cache.constFind (key) : cache.constEnd ();
+    if (i != cache.constEnd ()) {
+        *pxw = i.value ().width ();
+        *pxh = i.value ().height ();
+        return;
+    }
     QTextDocument td;
     td.setDefaultFont( font );
     td.setDocumentMargin (0);
@@ -798,11 +1079,73 @@ static void calculateTextDimensions (const QFont& font,
     *pxw = (int)td.idealWidth ();
     *pxh = (int)(r.y() + r.height());
     *pxw = qMin( (int)(*pxw + pixel_device_ratio), (int)w);
+    if (!textCacheEnabled ())
+        return;
+    if (cache.size () >= text_size_cache_max)
+        cache.clear ();
+    cache.insert (key, QSize (*pxw, *pxh));
 }
 
-static cairo_t *createContext (cairo_surface_t *similar, Surface *s, int w, int h) {
+/*
+ * Rasterize text of w x h pixels, laid out on a page of w x page_h.
+ * Qt paints straight into the pixels of a cairo image surface, so the
+ * only copy left is the one into the node's surface. Returns a new
+ * reference.
+ */
+static cairo_surface_t *textSurface (const QFont &font, const QString &text,
+        int w, int h, int page_h, bool markup_text, unsigned char align,
+        unsigned int background_color, int color = -1) {
+    static QCache <QString, CachedSurface> cache (text_image_cache_max);
+    const QString key = textCacheKey (font, text, w, h, page_h,
+            markup_text, align) +
+        QString::asprintf (" %x %d", background_color, color);
+    CachedSurface *cached = textCacheEnabled () ? cache.object (key) : nullptr;
+    if (cached)
+        return cairo_surface_reference (cached->surface);
+
+    bool have_alpha = (background_color & 0xff000000) < 0xff000000;
+    cairo_surface_t *sf = cairo_image_surface_create (
+            have_alpha ? CAIRO_FORMAT_ARGB32 : CAIRO_FORMAT_RGB24, w, h);
+    if (w <= 0 || h <= 0)
+        return sf;
+    cairo_surface_flush (sf);
+    QImage img (cairo_image_surface_get_data (sf), w, h,
+            cairo_image_surface_get_stride (sf),
+            have_alpha
+            ? QImage::Format_ARGB32_Premultiplied
+            : QImage::Format_RGB32);
+    img.fill (QColor::fromRgba (background_color));
+
+    QTextDocument td;
+    td.setDocumentMargin (0);
+    td.setDefaultFont (font);
+    td.setPageSize (QSize (w, page_h));
+    td.documentLayout()->setPaintDevice (&img);
+    setAlignment (td, align);
+    if (markup_text)
+        td.setHtml (text);
+    else
+        td.setPlainText (text);
+    QPainter painter;
+    painter.begin (&img);
+    QAbstractTextDocumentLayout::PaintContext ctx;
+    ctx.clip = QRect (0, 0, w, h);
+    if (color > -1)
+        ctx.palette.setColor (QPalette::Text, QColor (QRgb (color)));
+    td.documentLayout()->draw (&painter, ctx);
+    painter.end();
+    cairo_surface_mark_dirty (sf);
+
+    int cost = cairo_image_surface_get_stride (sf) * h;
+    if (cost <= text_image_cache_max / 4 && textCacheEnabled ())
+        cache.insert (key, new CachedSurface (cairo_surface_reference (sf)), cost);
+    return sf;
+}
+
+static cairo_t *createContext (cairo_surface_t *similar, Surface *s, int w, int h,
+        bool opaque_source=false) {
     unsigned int bg_alpha = s->background_color & 0xff000000;
-    bool clear = s->surface;
+    bool clear = s->surface && !opaque_source;
     if (!s->surface)
         s->surface = cairo_surface_create_similar (similar,
                 bg_alpha < 0xff000000
@@ -814,7 +1157,7 @@ static cairo_t *createContext (cairo_surface_t *similar, Surface *s, int w, int
         clearSurface (cr, IRect (0, 0, w, h));
     cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
 
-    if (bg_alpha) {
+    if (bg_alpha && !opaque_source) {
         if (bg_alpha < 0xff000000)
             CAIRO_SET_SOURCE_ARGB (cr, s->background_color);
         else
@@ -852,29 +1195,12 @@ void CairoPaintVisitor::visit (SMIL::TextMediaType * txt) {
             calculateTextDimensions (font, tm->text,
                     w, 2 * ft_size, scr.height (), &pxw, &pxh, false);
         }
-        QTextDocument td;
-        td.setDocumentMargin (0);
-        td.setDefaultFont (font);
-        bool have_alpha = (s->background_color & 0xff000000) < 0xff000000;
-        QImage img (QSize (pxw, pxh), have_alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
-        img.fill (s->background_color);
-        td.setPageSize (QSize (pxw, pxh + (int)ft_size));
-        td.documentLayout()->setPaintDevice (&img);
-        setAlignment (td, 1 + (int)txt->halign);
-        td.setPlainText (tm->text);
-        QPainter painter;
-        painter.begin (&img);
-        QAbstractTextDocumentLayout::PaintContext ctx;
-        ctx.clip = QRect (0, 0, pxw, pxh);
-        ctx.palette.setColor (QPalette::Text, QColor (QRgb (txt->font_color)));
-        td.documentLayout()->draw (&painter, ctx);
-        painter.end();
-
-        cairo_t *cr_txt = createContext (cairo_surface, s, pxw, pxh);
-        cairo_surface_t *src_sf = cairo_image_surface_create_for_data (
-                img.bits (),
-                have_alpha ? CAIRO_FORMAT_ARGB32:CAIRO_FORMAT_RGB24,
-                img.width(), img.height(), img.bytesPerLine ());
+        cairo_surface_t *src_sf = textSurface (font, tm->text, pxw, pxh,
+                pxh + (int)ft_size, false, 1 + (int)txt->halign,
+                s->background_color, txt->font_color & 0xffffff);
+
+        // the text raster already holds the background and covers it all
+        cairo_t *cr_txt = createContext (cairo_surface, s, pxw, pxh, true);
         cairo_pattern_t *pat = cairo_pattern_create_for_surface (src_sf);
         cairo_pattern_set_extend (pat, CAIRO_EXTEND_NONE);
         cairo_set_operator (cr_txt, CAIRO_OPERATOR_SOURCE);
@@ -932,7 +1258,7 @@ void CairoPaintVisitor::visit (SMIL::Brush * brush) {
         } else {
             CAIRO_SET_SOURCE_RGB (cr, color);
         }
-        cairo_fill (cr);
+        fillPath (1.0);
         if (opacity < 0.99)
             cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
         s->dirty = false;
@@ -1157,27 +1483,10 @@ void CairoPaintVisitor::visit (SMIL::SmilText *txt) {
             int voff = 0;
             while (b) {
                 cairo_translate (cr_txt, b->rect.x() - hoff, b->rect.y() - voff);
-                QTextDocument td;
-                td.setDocumentMargin (0);
-                td.setDefaultFont (b->font);
-                bool have_alpha = (s->background_color & 0xff000000) < 0xff000000;
-                QImage img (QSize (b->rect.width(), b->rect.height()), have_alpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
-                img.fill (s->background_color);
-                td.setPageSize (QSize (b->rect.width(), b->rect.height() + 10));
-                setAlignment (td, b->align);
-                td.documentLayout()->setPaintDevice (&img);
-                td.setHtml (b->rich_text);
-                QPainter painter;
-                painter.begin (&img);
-                QAbstractTextDocumentLayout::PaintContext ctx;
-                ctx.clip = QRect (QPoint (0, 0), img.size ());
-                td.documentLayout()->draw (&painter, ctx);
-                painter.end();
-
-                cairo_surface_t *src_sf = cairo_image_surface_create_for_data (
-                        img.bits (),
-                        have_alpha ? CAIRO_FORMAT_ARGB32:CAIRO_FORMAT_RGB24,
-                        img.width(), img.height(), img.bytesPerLine ());
+                cairo_surface_t *src_sf = textSurface (b->font, b->rich_text,
+                        b->rect.width(), b->rect.height(),
+                        b->rect.height() + 10, true, b->align,
+                        s->background_color);
                 cairo_pattern_t *pat = cairo_pattern_create_for_surface (src_sf);
                 cairo_pattern_set_extend (pat, CAIRO_EXTEND_NONE);
                 cairo_set_operator (cr_txt, CAIRO_OPERATOR_SOURCE);
@@ -1770,7 +2079,11 @@ public:
 #endif
     }
 #ifdef KMPLAYER_WITH_CAIRO
+    /* without X, as with -platform offscreen, paint into an image and
+     * let paintEvent draw that */
     cairo_surface_t *createSurface (int w, int h) {
+        if (!QX11Info::isPlatformX11 ())
+            return cairo_image_surface_create (CAIRO_FORMAT_RGB24, w, h);
         xcb_connection_t* connection = QX11Info::connection();
         destroyBackingStore ();
         xcb_screen_t* scr = screen_of_display(connection, QX11Info::appScreen());
@@ -1784,6 +2097,12 @@ public:
         return cairo_xcb_surface_create(connection, backing_store, visual_of_screen(connection, scr), w, h);
     }
     void swapBuffer (const IRect &sr, int dx, int dy) {
+        if (!QX11Info::isPlatformX11 ()) {
+            qreal dpr = m_view_area->devicePixelRatioF ();
+            m_view_area->update (QRectF (dx / dpr, dy / dpr,
+                        sr.width () / dpr, sr.height () / dpr).toAlignedRect ());
+            return;
+        }
         xcb_connection_t* connection = QX11Info::connection();
         if (!gc) {
             gc = xcb_generate_id(connection);
@@ -1867,6 +2186,7 @@ ViewArea::ViewArea (QWidget *, View * view, bool paint_bg)
    m_view (view),
    m_collection (new KActionCollection (this)),
    surface (new Surface (this)),
+   m_painted_pixels (0),
    m_mouse_invisible_timer (0),
    m_repaint_timer (0),
    m_restore_fullscreen_timer (0),
@@ -1993,83 +2313,149 @@ void ViewArea::mouseMoveEvent (QMouseEvent * e) {
     mouseMoved (); // for m_mouse_invisible_timer
 }
 
+static int rectArea (const IRect &r) {
+    return r.isEmpty () ? 0 : r.width () * r.height ();
+}
+
+#ifdef KMPLAYER_WITH_CAIRO
+static IRect expandDamage (const IRect &rect) {
+    int ex = rect.x ();
+    if (ex > 0)
+        ex--;
+    int ey = rect.y ();
+    if (ey > 0)
+        ey--;
+    return IRect (ex, ey, rect.width () + 2, rect.height () + 2);
+}
+#endif
+
 void ViewArea::syncVisual () {
     pixel_device_ratio = devicePixelRatioF();
     int w = (int)(width() * devicePixelRatioF());
     int h = (int)(height() * devicePixelRatioF());
-    IRect rect = m_repaint_rect.intersect (IRect (0, 0, w, h));
+    const IRect screen (0, 0, w, h);
+    m_painted_pixels = 0;
 #ifdef KMPLAYER_WITH_CAIRO
     if (surface->node) {
-        int ex = rect.x ();
-        if (ex > 0)
-            ex--;
-        int ey = rect.y ();
-        if (ey > 0)
-            ey--;
-        int ew = rect.width () + 2;
-        int eh = rect.height () + 2;
-        IRect swap_rect;
-        cairo_surface_t *merge = nullptr;
-        cairo_pattern_t *pat = nullptr;
-        cairo_t *cr = nullptr;
         if (!surface->surface) {
+            IRect rect;
+            for (int i = 0; i < m_repaint_rects.size (); ++i)
+                rect = rect.unite (m_repaint_rects[i].intersect (screen));
+            IRect swap_rect = expandDamage (rect);
             surface->surface = d->createSurface(w, h);
-            swap_rect = IRect (ex, ey, ew, eh);
             CairoPaintVisitor visitor (surface->surface,
                     Matrix (surface->bounds.x(), surface->bounds.y(),
                         surface->xscale, surface->yscale),
                     swap_rect,
                     palette ().color (backgroundRole ()), true);
             surface->node->accept (&visitor);
-            m_update_rect = IRect ();
-        } else if (!rect.isEmpty ()) {
-            merge = cairo_surface_create_similar (surface->surface,
-                    CAIRO_CONTENT_COLOR, ew, eh);
-            {
-                CairoPaintVisitor visitor (merge,
-                        Matrix (surface->bounds.x()-ex, surface->bounds.y()-ey,
-                            surface->xscale, surface->yscale),
-                        IRect (0, 0, ew, eh),
-                        palette ().color (backgroundRole ()), true);
-                surface->node->accept (&visitor);
-            }
-            cr = cairo_create (surface->surface);
-            pat = cairo_pattern_create_for_surface (merge);
-            cairo_pattern_set_extend (pat, CAIRO_EXTEND_NONE);
-            cairo_matrix_t mat;
-            cairo_matrix_init_translate (&mat, (int) -ex, (int) -ey);
-            cairo_pattern_set_matrix (pat, &mat);
-            cairo_set_source (cr, pat);
-            //cairo_set_operator (cr, CAIRO_OPERATOR_ADD);
-            cairo_rectangle (cr, ex, ey, ew, eh);
-            //cairo_fill (cr);
-            cairo_clip (cr);
-            cairo_paint_with_alpha (cr, .8);
-            swap_rect = IRect (ex, ey, ew, eh).unite (m_update_rect);
-            m_update_rect = IRect (ex, ey, ew, eh);
+            m_painted_pixels = rectArea (swap_rect);
+            m_update_rects.clear ();
+            d->swapBuffer (swap_rect, swap_rect.x (), swap_rect.y ());
         } else {
-            swap_rect = m_update_rect;
-            m_update_rect = IRect ();
-        }
-        d->swapBuffer (swap_rect, swap_rect.x (), swap_rect.y ());
-        if (merge) {
-            cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
-            cairo_rectangle (cr, ex, ey, ew, eh);
-            cairo_fill (cr);
-            cairo_destroy (cr);
-            cairo_pattern_destroy (pat);
-            cairo_surface_destroy (merge);
+            // show the final content of the previous update
+            for (int i = 0; i < m_update_rects.size (); ++i) {
+                const IRect &r = m_update_rects[i];
+                d->swapBuffer (r, r.x (), r.y ());
+            }
+            m_update_rects.clear ();
+            for (int i = 0; i < m_repaint_rects.size (); ++i) {
+                IRect rect = m_repaint_rects[i].intersect (screen);
+                if (rect.isEmpty ())
+                    continue;
+                rect = expandDamage (rect);
+                int ex = rect.x ();
+                int ey = rect.y ();
+                int ew = rect.width ();
+                int eh = rect.height ();
+                cairo_surface_t *merge = cairo_surface_create_similar (
+                        surface->surface, CAIRO_CONTENT_COLOR, ew, eh);
+                {
+                    CairoPaintVisitor visitor (merge,
+                            Matrix (surface->bounds.x()-ex, surface->bounds.y()-ey,
+                                surface->xscale, surface->yscale),
+                            IRect (0, 0, ew, eh),
+                            palette ().color (backgroundRole ()), true);
+                    surface->node->accept (&visitor);
+                }
+                cairo_t *cr = cairo_create (surface->surface);
+                cairo_pattern_t *pat = cairo_pattern_create_for_surface (merge);
+                cairo_pattern_set_extend (pat, CAIRO_EXTEND_NONE);
+                cairo_matrix_t mat;
+                cairo_matrix_init_translate (&mat, (int) -ex, (int) -ey);
+                cairo_pattern_set_matrix (pat, &mat);
+                cairo_set_source (cr, pat);
+                cairo_rectangle (cr, ex, ey, ew, eh);
+                cairo_clip (cr);
+                cairo_paint_with_alpha (cr, .8);
+                d->swapBuffer (rect, ex, ey);
+                cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+                cairo_rectangle (cr, ex, ey, ew, eh);
+                cairo_fill (cr);
+                cairo_destroy (cr);
+                cairo_pattern_destroy (pat);
+                cairo_surface_destroy (merge);
+                m_update_rects.push_back (rect);
+                m_painted_pixels += ew * eh;
+            }
         }
         cairo_surface_flush (surface->surface);
     } else
 #endif
     {
-        m_update_rect = IRect ();
-        repaint(QRect(rect.x() / devicePixelRatioF(),
-                      rect.y() / devicePixelRatioF(),
-                      rect.width() / devicePixelRatioF(),
-                      rect.height() / devicePixelRatioF()));
+        m_update_rects.clear ();
+        for (int i = 0; i < m_repaint_rects.size (); ++i) {
+            IRect rect = m_repaint_rects[i].intersect (screen);
+            if (rect.isEmpty ())
+                continue;
+            m_painted_pixels += rectArea (rect);
+            repaint(QRect(rect.x() / devicePixelRatioF(),
+                          rect.y() / devicePixelRatioF(),
+                          rect.width() / devicePixelRatioF(),
+                          rect.height() / devicePixelRatioF()));
+        }
+    }
+}
+
+/*
+ * Send the updaters one frame and paint the whole document into an image,
+ * optionally saved as PNG. Returns the paint time in microseconds or -1.
+ */
+qint64 ViewArea::renderOffscreen (const QString &png_file) {
+#ifdef KMPLAYER_WITH_CAIRO
+    if (!surface->node)
+        return -1;
+    Connection *connect = m_updaters.first ();
+    if (m_updaters_enabled && connect) {
+        UpdateEvent event (connect->connecter->document (), 0);
+        for (; connect; connect = m_updaters.next ())
+            if (connect->connecter)
+                connect->connecter->message (MsgSurfaceUpdate, &event);
+    }
+    pixel_device_ratio = devicePixelRatioF();
+    int w = (int)(width() * devicePixelRatioF());
+    int h = (int)(height() * devicePixelRatioF());
+    QElapsedTimer timer;
+    timer.start ();
+    cairo_surface_t *img = cairo_image_surface_create (CAIRO_FORMAT_RGB24, w, h);
+    {
+        CairoPaintVisitor visitor (img,
+                Matrix (surface->bounds.x(), surface->bounds.y(),
+                    surface->xscale, surface->yscale),
+                IRect (0, 0, w, h),
+                palette ().color (backgroundRole ()), true);
+        surface->node->accept (&visitor);
     }
+    cairo_surface_flush (img);
+    qint64 usec = timer.nsecsElapsed () / 1000;
+    if (!png_file.isEmpty ())
+        cairo_surface_write_to_png (img, QFile::encodeName (png_file).constData ());
+    cairo_surface_destroy (img);
+    return usec;
+#else
+    Q_UNUSED(png_file)
+    return -1;
+#endif
 }
 
 void ViewArea::paintEvent (QPaintEvent * pe) {
@@ -2079,7 +2465,20 @@ void ViewArea::paintEvent (QPaintEvent * pe) {
         int y = (int)(pe->rect().y() * devicePixelRatioF());
         int w = (int)(pe->rect().width() * devicePixelRatioF());
         int h = (int)(pe->rect().height() * devicePixelRatioF());
-        scheduleRepaint(IRect(x, y, w, h));
+        if (!QX11Info::isPlatformX11 () && surface->surface) {
+            // the backing store is an image, see ViewerAreaPrivate
+            cairo_surface_t *sf = surface->surface;
+            cairo_surface_flush (sf);
+            QImage img (cairo_image_surface_get_data (sf),
+                    cairo_image_surface_get_width (sf),
+                    cairo_image_surface_get_height (sf),
+                    cairo_image_surface_get_stride (sf), QImage::Format_RGB32);
+            QPainter p (this);
+            p.drawImage (QRectF (pe->rect ()), img, QRectF (x, y, w, h));
+            p.end ();
+        } else {
+            scheduleRepaint(IRect(x, y, w, h));
+        }
     } else
 #endif
         if (m_fullscreen || m_paint_background)
@@ -2092,7 +2491,7 @@ void ViewArea::paintEvent (QPaintEvent * pe) {
 
 QPaintEngine *ViewArea::paintEngine () const {
 #ifdef KMPLAYER_WITH_CAIRO
-    if (surface->node)
+    if (surface->node && QX11Info::isPlatformX11 ())
         return nullptr;
     else
 #endif
@@ -2176,7 +2575,7 @@ Surface *ViewArea::getSurface (Mrl *mrl) {
         updateSurfaceBounds ();
 #ifdef KMPLAYER_WITH_CAIRO
         setAttribute (Qt::WA_OpaquePaintEvent, true);
-        setAttribute (Qt::WA_PaintOnScreen, true);
+        setAttribute (Qt::WA_PaintOnScreen, QX11Info::isPlatformX11 ());
 #endif
         return surface.ptr ();
     } else {
@@ -2217,12 +2616,45 @@ void ViewArea::mouseMoved () {
     }
 }
 
+/*
+ * Damage is kept as a few rectangles, so that two small animating regions
+ * far apart don't repaint everything in between. A rectangle is merged
+ * with an existing one when their union isn't larger than both together,
+ * once max_damage_rects are collected with the one that grows the least.
+ */
+static const int max_damage_rects = 8;
+
 void ViewArea::scheduleRepaint (const IRect &rect) {
-    if (m_repaint_timer) {
-        m_repaint_rect = m_repaint_rect.unite (rect);
-    } else {
-        m_repaint_rect = rect;
+    if (!m_repaint_timer)
         m_repaint_timer = startTimer (25);
+    if (rect.isEmpty ())
+        return;
+    IRect r = rect;
+    for (int i = 0; i < m_repaint_rects.size (); ) {
+        IRect u = m_repaint_rects[i].unite (r);
+        if (rectArea (u) <= rectArea (m_repaint_rects[i]) + rectArea (r)) {
+            m_repaint_rects[i] = m_repaint_rects.last ();
+            m_repaint_rects.pop_back ();
+            r = u;
+            i = 0; // the union may overlap rectangles checked already
+        } else {
+            ++i;
+        }
+    }
+    if (m_repaint_rects.size () < max_damage_rects) {
+        m_repaint_rects.push_back (r);
+    } else {
+        int best = 0;
+        int best_growth = -1;
+        for (int i = 0; i < m_repaint_rects.size (); ++i) {
+            const IRect &d = m_repaint_rects[i];
+            int growth = rectArea (d.unite (r)) - rectArea (d);
+            if (best_growth < 0 || growth < best_growth) {
+                best = i;
+                best_growth = growth;
+            }
+        }
+        m_repaint_rects[best] = m_repaint_rects[best].unite (r);
     }
 }
 
@@ -2243,7 +2675,7 @@ void ViewArea::enableUpdaters (bool enable, unsigned int skip) {
         if (!m_repaint_timer)
             m_repaint_timer = startTimer (25);
     } else if (!enable && m_repaint_timer &&
-            m_repaint_rect.isEmpty () && m_update_rect.isEmpty ()) {
+            m_repaint_rects.isEmpty () && m_update_rects.isEmpty ()) {
         killTimer (m_repaint_timer);
         m_repaint_timer = 0;
     }
@@ -2264,17 +2696,22 @@ void ViewArea::timerEvent (QTimerEvent * e) {
                 if (connect->connecter)
                     connect->connecter->message (MsgSurfaceUpdate, &event);
         }
-        //repaint (m_repaint_rect, false);
-        if (!m_repaint_rect.isEmpty () || !m_update_rect.isEmpty ()) {
+        if (!m_repaint_rects.isEmpty () || !m_update_rects.isEmpty ()) {
             syncVisual ();
-            m_repaint_rect = IRect ();
+            m_repaint_rects.clear ();
         }
-        if (m_update_rect.isEmpty () &&
+        if (m_update_rects.isEmpty () &&
                 (!m_updaters_enabled || !m_updaters.first ())) {
             killTimer (m_repaint_timer);
             m_repaint_timer = 0;
         }
     } else if (e->timerId () == m_restore_fullscreen_timer) {
+        if (!QX11Info::isPlatformX11 ()) {
+            m_view->dockArea ()->setCentralWidget (this);
+            killTimer(m_restore_fullscreen_timer);
+            m_restore_fullscreen_timer = 0;
+            return;
+        }
         xcb_connection_t* connection = QX11Info::connection();
         xcb_get_window_attributes_cookie_t cookie = xcb_get_window_attributes(connection, winId());
         xcb_get_window_attributes_reply_t* attrs = xcb_get_window_attributes_reply(connection, cookie, nullptr);
@@ -2328,6 +2765,8 @@ void ViewArea::setVideoWidgetVisible (bool show) {
 }
 
 static void setXSelectInput(WId wid, uint32_t mask) {
+    if (!QX11Info::isPlatformX11 ())
+        return;
     xcb_connection_t* connection = QX11Info::connection();
     const uint32_t values[] = { mask };
     xcb_change_window_attributes(connection, wid, XCB_CW_EVENT_MASK, values);
@@ -2453,12 +2892,14 @@ VideoOutput::VideoOutput (QWidget *parent, View * view)
     setMonitoring (MonitorAll);
     setAttribute (Qt::WA_NoSystemBackground, true);
 
-    xcb_connection_t* connection = QX11Info::connection();
-    xcb_get_window_attributes_cookie_t cookie = xcb_get_window_attributes(connection, winId());
-    xcb_get_window_attributes_reply_t* attrs = xcb_get_window_attributes_reply(connection, cookie, nullptr);
-    if (!(attrs->your_event_mask & XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY))
-        setXSelectInput(winId(), attrs->your_event_mask | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY);
-    free(attrs);
+    if (QX11Info::isPlatformX11 ()) {
+        xcb_connection_t* connection = QX11Info::connection();
+        xcb_get_window_attributes_cookie_t cookie = xcb_get_window_attributes(connection, winId());
+        xcb_get_window_attributes_reply_t* attrs = xcb_get_window_attributes_reply(connection, cookie, nullptr);
+        if (!(attrs->your_event_mask & XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY))
+            setXSelectInput(winId(), attrs->your_event_mask | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY);
+        free(attrs);
+    }
     //setProtocol (QXEmbed::XPLAIN);
 }
 
@@ -2474,6 +2915,8 @@ VideoOutput::~VideoOutput () {
 
 void VideoOutput::useIndirectWidget (bool inderect) {
     qCDebug(LOG_KMPLAYER_COMMON) << "setIntermediateWindow " << !!m_plain_window << "->" << inderect;
+    if (!QX11Info::isPlatformX11 ())
+        return;
     if (!clientWinId () || !!m_plain_window != inderect) {
         xcb_connection_t* connection = QX11Info::connection();
         if (inderect) {
@@ -2525,7 +2968,7 @@ void VideoOutput::timerEvent (QTimerEvent *e) {
     if (e->timerId () == resized_timer) {
         killTimer (resized_timer);
         resized_timer = 0;
-        if (clientWinId ()) {
+        if (clientWinId () && QX11Info::isPlatformX11 ()) {
             xcb_connection_t* connection = QX11Info::connection();
             uint32_t devicew = (uint32_t)(width() * devicePixelRatioF());
             uint32_t deviceh = (uint32_t)(height() * devicePixelRatioF());
@@ -2653,7 +3096,7 @@ void VideoOutput::setCurrentBackgroundColor (const QColor & c) {
     QPalette palette;
     palette.setColor (backgroundRole(), c);
     setPalette (palette);
-    if (clientWinId()) {
+    if (clientWinId() && QX11Info::isPlatformX11 ()) {
         xcb_connection_t* connection = QX11Info::connection();
         const uint32_t values[] = { c.rgb() };
         xcb_change_window_attributes(connection, clientWinId(), XCB_CW_BACK_PIXEL, values);
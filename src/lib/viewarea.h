@@ -12,6 +12,7 @@
 #include <QAbstractNativeEventFilter>
 typedef QWidget QX11EmbedContainer;
 #include <QList>
+#include <QVector>
 
 #include "mediaobject.h"
 #include "surface.h"
@@ -43,6 +44,7 @@ public:
     Surface *getSurface(Mrl* mrl) KMPLAYERCOMMON_NO_EXPORT;
     void mouseMoved() KMPLAYERCOMMON_NO_EXPORT;
     void scheduleRepaint(const IRect& rect) KMPLAYERCOMMON_NO_EXPORT;
+    KMPLAYERCOMMON_NO_EXPORT unsigned int paintedPixels () const { return m_painted_pixels; }
     ConnectionList* updaters() KMPLAYERCOMMON_NO_EXPORT;
     void resizeEvent(QResizeEvent*) override KMPLAYERCOMMON_NO_EXPORT;
     void enableUpdaters(bool enable, unsigned int off_time) KMPLAYERCOMMON_NO_EXPORT;
@@ -50,6 +52,7 @@ public:
     IViewer *createVideoWidget ();
     void destroyVideoWidget (IViewer *widget);
     void setVideoWidgetVisible (bool show);
+    qint64 renderOffscreen (const QString &png_file);
 Q_SIGNALS:
     void fullScreenChanged ();
 public Q_SLOTS:
@@ -80,8 +83,9 @@ private:
     View * m_view;
     KActionCollection * m_collection;
     SurfacePtr surface;
-    IRect m_repaint_rect;
-    IRect m_update_rect;
+    QVector <IRect> m_repaint_rects; // damage in screen coordinates
+    QVector <IRect> m_update_rects;  // painted, still to be swapped
+    unsigned int m_painted_pixels;   // pixels painted in last syncVisual
     QRect m_topwindow_rect;
     typedef QList <IViewer *> VideoWidgetList;
     VideoWidgetList video_widgets;
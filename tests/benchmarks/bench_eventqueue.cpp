@@ -0,0 +1,98 @@
+/*
+    SPDX-FileCopyrightText: 2026 Koos Vriezen <koos.vriezen@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+/*
+ * Event queue microbenchmark, posts, pauses, cancels and dispatches
+ * TimerPostings against a Document without a GUI.
+ *
+ *   bench_eventqueue [count]   (default 100000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QUrl>
+
+#include "kmplayerplaylist.h"
+
+using namespace KMPlayer;
+
+namespace {
+
+class Notify : public PlayListNotify
+{
+public:
+    Notify () : timeouts (0) {}
+    void stateElementChanged (Node *, Node::State, Node::State) override {}
+    void bitRates (int &preferred, int &maximal) override {
+        preferred = maximal = 0;
+    }
+    void setTimeout (int) override { ++timeouts; }
+    void openUrl (const QUrl &, const QString &, const QString &) override {}
+    void enableRepaintUpdaters (bool, unsigned int) override {}
+    int timeouts;
+};
+
+}
+
+static void report (const char *what, int count, qint64 nsec) {
+    printf ("%-10s %8d ops %10.2f ms %8.1f ns/op\n",
+            what, count, nsec / 1e6, count ? 1.0 * nsec / count : 0.0);
+}
+
+int main (int argc, char **argv) {
+    QCoreApplication app (argc, argv);
+    int count = argc > 1 ? atoi (argv[1]) : 100000;
+    if (count <= 0)
+        count = 100000;
+
+    Notify notify;
+    NodePtr doc = new Document (QString (), &notify);
+    Document *d = doc->document ();
+    // no media gets resolved, just make timer() accept the dispatching
+    d->state = Node::state_began;
+    d->setVirtualClock (true);
+
+    QVector <Posting *> postings (count);
+    QElapsedTimer timer;
+    srand (1);
+
+    timer.start ();
+    for (int i = 0; i < count; ++i)
+        postings[i] = d->post (d, new TimerPosting (rand () % 60000, i));
+    report ("post", count, timer.nsecsElapsed ());
+
+    int paused = 0;
+    timer.start ();
+    for (int i = 1; i < count; i += 4, ++paused)
+        d->pausePosting (postings[i]);
+    report ("pause", paused, timer.nsecsElapsed ());
+
+    timer.start ();
+    for (int i = 1; i < count; i += 4)
+        d->unpausePosting (postings[i], rand () % 60000);
+    report ("unpause", paused, timer.nsecsElapsed ());
+
+    int cancelled = 0;
+    timer.start ();
+    for (int i = 0; i < count; i += 2, ++cancelled)
+        d->cancelPosting (postings[i]);
+    report ("cancel", cancelled, timer.nsecsElapsed ());
+
+    d->timer_stats.reset ();
+    timer.start ();
+    d->advanceClock (120000);
+    report ("dispatch", d->timer_stats.events, timer.nsecsElapsed ());
+    printf ("wakeups %u, most events per wakeup %u, listener timeouts %d\n",
+            d->timer_stats.wakeups, d->timer_stats.max_events,
+            notify.timeouts);
+
+    d->state = Node::state_init;
+    d->dispose ();
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*
+    SPDX-FileCopyrightText: 2026 Koos Vriezen <koos.vriezen@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+/*
+ * SMIL state expression benchmark, compares the cost of parsing an
+ * expression with evaluating an already parsed one, and with the
+ * compiledExpr cache lookup plus evaluation used by the SMIL code.
+ *
+ *   bench_expression [iterations]   (default 10000)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include "kmplayerplaylist.h"
+#include "expression.h"
+
+using namespace KMPlayer;
+
+static const char *expressions[] = {
+    "/data/books/book[title = \"Tom Sawyer\"]/author",
+    "//book/title[1]",
+    "/data/books/book[position() = 2]/title",
+    "//book[last()]/author",
+    "/data/books/book/title[contains(., 'Pygma')]",
+    "number(/data/books/book)",
+    "count(//book) > 100 and string-length(//book[3]/title) = 7",
+    nullptr
+};
+
+static QString stateData () {
+    QString data ("<data><books>");
+    for (int i = 0; i < 200; ++i)
+        data += QString ("<book><title>Title %1</title>"
+                "<author>Author %2</author></book>").arg (i).arg (i % 17);
+    data += "<book><title>Tom Sawyer</title><author>Mark Twain</author></book>"
+        "<book><title>Pygmalion</title><author>George Bernard Shaw</author></book>"
+        "</books></data>";
+    return data;
+}
+
+int main (int argc, char **argv) {
+    QCoreApplication app (argc, argv);
+    int iterations = argc > 1 ? atoi (argv[1]) : 10000;
+    if (iterations <= 0)
+        iterations = 10000;
+    Ids::init ();
+
+    NodePtr doc = new Document (QString ());
+    QString xml = stateData ();
+    QTextStream in (&xml);
+    readXML (doc, in, QString (), false);
+    Node *root = doc->firstChild ();
+
+    QElapsedTimer timer;
+    printf ("%-56s %10s %10s %10s\n", "ns per expression", "parse", "eval", "cached");
+    for (int i = 0; expressions[i]; ++i) {
+        const QByteArray expr (expressions[i]);
+
+        timer.start ();
+        for (int j = 0; j < iterations; ++j)
+            delete evaluateExpr (expr, "data");
+        qint64 parse = timer.nsecsElapsed ();
+
+        Expression *e = evaluateExpr (expr, "data");
+        if (!e) {
+            printf ("%-56s doesn't parse\n", expressions[i]);
+            continue;
+        }
+        QString value;
+        timer.start ();
+        for (int j = 0; j < iterations; ++j) {
+            e->setRoot (root); // invalidates the previous result
+            value = e->toString ();
+        }
+        qint64 eval = timer.nsecsElapsed ();
+        delete e;
+
+        const QString source = QString::fromUtf8 (expr);
+        timer.start ();
+        for (int j = 0; j < iterations; ++j) {
+            Expression *c = compiledExpr (source, "data");
+            c->setRoot (root);
+            value = c->toString ();
+        }
+        qint64 cached = timer.nsecsElapsed ();
+
+        printf ("%-56s %10.0f %10.0f %10.0f\n", expressions[i],
+                1.0 * parse / iterations, 1.0 * eval / iterations,
+                1.0 * cached / iterations);
+        printf ("  = %s\n", qPrintable (value.left (60)));
+    }
+
+    doc->document ()->dispose ();
+    Ids::reset ();
+    return 0;
+}
@@ -0,0 +1,155 @@
+/*
+    SPDX-FileCopyrightText: 2026 Koos Vriezen <koos.vriezen@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+/*
+ * XML playlist parse benchmark. Times readXML, which uses the built in
+ * SimpleSAXParser or expat depending on KMPLAYER_BUILT_WITH_EXPAT, and,
+ * when expat is found, a bare expat SAX pass without building a tree.
+ *
+ *   bench_parser [file ...]   (default a generated 50000 entry ASX)
+ */
+
+#include <stdio.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#ifdef BENCH_WITH_EXPAT
+#include <expat.h>
+#endif
+
+#include "config-kmplayer.h"
+#include "kmplayerplaylist.h"
+
+using namespace KMPlayer;
+
+static const int runs = 5;
+
+static QByteArray generatedPlaylist () {
+    QByteArray data ("<asx version=\"3.0\">\n<title>generated</title>\n");
+    for (int i = 0; i < 50000; ++i)
+        data += QString ("<entry><title>Entry &amp; number %1</title>"
+                "<ref href=\"http://example.org/media/%1.ogg\"/>"
+                "<param name=\"index\" value=\"%1\"/></entry>\n")
+            .arg (i).toUtf8 ();
+    data += "</asx>\n";
+    return data;
+}
+
+static void report (const char *what, int size, qint64 nsec) {
+    printf ("  %-12s %9.2f ms %8.1f MB/s\n",
+            what, nsec / 1e6, nsec ? size * 1e3 / nsec : 0.0);
+}
+
+static qint64 timeReadXML (const QByteArray &data, int *nodes) {
+    QElapsedTimer timer;
+    qint64 best = 0;
+    for (int r = 0; r < runs; ++r) {
+        NodePtr doc = new Document (QString ());
+        QTextStream in (data);
+        timer.start ();
+        readXML (doc, in, QString (), false);
+        qint64 nsec = timer.nsecsElapsed ();
+        if (!r || nsec < best)
+            best = nsec;
+        *nodes = 0;
+        for (Node *n = doc.ptr (); n; ) {
+            ++*nodes;
+            if (n->firstChild ()) {
+                n = n->firstChild ();
+                continue;
+            }
+            while (n && !n->nextSibling ())
+                n = n->parentNode ();
+            if (n)
+                n = n->nextSibling ();
+        }
+        doc->document ()->dispose ();
+    }
+    return best;
+}
+
+#ifdef BENCH_WITH_EXPAT
+/* do the QString conversions DocumentBuilder needs, but build no tree */
+struct ExpatCounts {
+    int elements;
+    int length;
+};
+
+static void XMLCALL startTag (void *data, const char *tag, const char **attr) {
+    ExpatCounts *counts = static_cast <ExpatCounts *> (data);
+    counts->length += QString::fromUtf8 (tag).length ();
+    for (int i = 0; attr[i]; i += 2)
+        counts->length += QString::fromUtf8 (attr[i]).length () +
+            QString::fromUtf8 (attr[i+1]).length ();
+    counts->elements++;
+}
+
+static void XMLCALL endTag (void *, const char *) {}
+
+static void XMLCALL characterData (void *data, const char *s, int len) {
+    static_cast <ExpatCounts *> (data)->length += QString::fromUtf8 (s, len).length ();
+}
+
+static qint64 timeExpat (const QByteArray &data, int *elements) {
+    QElapsedTimer timer;
+    qint64 best = 0;
+    for (int r = 0; r < runs; ++r) {
+        XML_Parser parser = XML_ParserCreate (nullptr);
+        ExpatCounts counts = { 0, 0 };
+        XML_SetUserData (parser, &counts);
+        XML_SetElementHandler (parser, startTag, endTag);
+        XML_SetCharacterDataHandler (parser, characterData);
+        timer.start ();
+        if (XML_Parse (parser, data.constData (), data.size (), true) == XML_STATUS_ERROR)
+            fprintf (stderr, "expat: %s\n",
+                    XML_ErrorString (XML_GetErrorCode (parser)));
+        qint64 nsec = timer.nsecsElapsed ();
+        if (!r || nsec < best)
+            best = nsec;
+        *elements = counts.elements;
+        XML_ParserFree (parser);
+    }
+    return best;
+}
+#endif
+
+static void bench (const QString &name, const QByteArray &data) {
+    int count = 0;
+    printf ("%s: %d bytes, best of %d\n", qPrintable (name), data.size (), runs);
+    qint64 nsec = timeReadXML (data, &count);
+#ifdef KMPLAYER_WITH_EXPAT
+    report ("readXML/expat", data.size (), nsec);
+#else
+    report ("readXML", data.size (), nsec);
+#endif
+    printf ("  %d nodes\n", count);
+#ifdef BENCH_WITH_EXPAT
+    nsec = timeExpat (data, &count);
+    report ("expat SAX", data.size (), nsec);
+    printf ("  %d elements\n", count);
+#endif
+}
+
+int main (int argc, char **argv) {
+    QCoreApplication app (argc, argv);
+    Ids::init ();
+    if (argc < 2) {
+        bench ("generated", generatedPlaylist ());
+    } else {
+        for (int i = 1; i < argc; ++i) {
+            QFile file (QString::fromLocal8Bit (argv[i]));
+            if (!file.open (QIODevice::ReadOnly)) {
+                fprintf (stderr, "can't open %s\n", argv[i]);
+                continue;
+            }
+            bench (file.fileName (), file.readAll ());
+        }
+    }
+    Ids::reset ();
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+    SPDX-FileCopyrightText: 2026 Koos Vriezen <koos.vriezen@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+/*
+ * SMIL parse benchmark. For each file, times readXML, which creates the
+ * elements through childFromTag, and an init pass over the elements,
+ * which feeds all attributes through parseParam. Best of a number of runs.
+ *
+ *   bench_smil [-n runs] file ...   (e.g. the .smil files in tests)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+
+#include "config-kmplayer.h"
+#include "kmplayerplaylist.h"
+
+using namespace KMPlayer;
+
+struct Timing {
+    Timing () : parse (0), init (0), elements (0) {}
+
+    qint64 parse;
+    qint64 init;
+    int elements;
+};
+
+static Node *nextNode (Node *n) {
+    if (n->firstChild ())
+        return n->firstChild ();
+    while (n && !n->nextSibling ())
+        n = n->parentNode ();
+    return n ? n->nextSibling () : nullptr;
+}
+
+static Timing timeFile (const QByteArray &data, int runs) {
+    QElapsedTimer timer;
+    Timing best;
+    for (int r = 0; r < runs; ++r) {
+        Timing t;
+        NodePtr doc = new Document (QString ());
+        QTextStream in (data);
+        timer.start ();
+        readXML (doc, in, QString (), false);
+        t.parse = timer.nsecsElapsed ();
+
+        timer.start ();
+        for (Node *n = doc->firstChild (); n; n = nextNode (n))
+            if (n->isElementNode ()) {
+                static_cast <Element *> (n)->init ();
+                t.elements++;
+            }
+        t.init = timer.nsecsElapsed ();
+
+        if (!r || t.parse < best.parse)
+            best.parse = t.parse;
+        if (!r || t.init < best.init)
+            best.init = t.init;
+        best.elements = t.elements;
+        doc->document ()->dispose ();
+    }
+    return best;
+}
+
+int main (int argc, char **argv) {
+    QCoreApplication app (argc, argv);
+    int runs = 20;
+    int first = 1;
+    if (argc > 2 && !strcmp (argv[1], "-n")) {
+        runs = qMax (1, atoi (argv[2]));
+        first = 3;
+    }
+    if (first >= argc) {
+        fprintf (stderr, "usage: %s [-n runs] file ...\n", argv[0]);
+        return 1;
+    }
+    Ids::init ();
+    printf ("%-28s %8s %10s %10s %9s\n",
+            "file", "elements", "parse us", "init us", "ns/elem");
+    Timing total;
+    for (int i = first; i < argc; ++i) {
+        QFile file (QString::fromLocal8Bit (argv[i]));
+        if (!file.open (QIODevice::ReadOnly)) {
+            fprintf (stderr, "can't open %s\n", argv[i]);
+            continue;
+        }
+        Timing t = timeFile (file.readAll (), runs);
+        printf ("%-28s %8d %10.1f %10.1f %9.0f\n",
+                qPrintable (file.fileName ().section ('/', -1)), t.elements,
+                t.parse / 1e3, t.init / 1e3,
+                t.elements ? double (t.parse + t.init) / t.elements : 0.0);
+        total.parse += t.parse;
+        total.init += t.init;
+        total.elements += t.elements;
+    }
+    printf ("%-28s %8d %10.1f %10.1f %9.0f\n", "total", total.elements,
+            total.parse / 1e3, total.init / 1e3,
+            total.elements
+                ? double (total.parse + total.init) / total.elements : 0.0);
+    Ids::reset ();
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*
+    SPDX-FileCopyrightText: 2026 Koos Vriezen <koos.vriezen@gmail.com>
+
+    SPDX-License-Identifier: LGPL-2.0-only
+*/
+
+/*
+ * Interns, copies and drops TrieStrings from several threads at once. The
+ * words share prefixes, so the threads split and merge the same trie nodes.
+ * Exits non-zero when a string doesn't read back or compare as expected.
+ *
+ *   triestring_stress [threads [iterations]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QString>
+#include <QThread>
+#include <QVector>
+
+#include "triestring.h"
+
+using namespace KMPlayer;
+
+static const char *words [] = {
+    "r", "re", "reg", "region", "regionName", "regPoint", "regAlign",
+    "fill", "fit", "font", "fontSize", "fontFace", "fontColor",
+    "begin", "beginEvent", "end", "endsync", "id", "src", "system",
+    "systemBitrate", "systemLanguage", nullptr
+};
+
+static QAtomicInt failures;
+
+static void check (bool ok, const char *what, const QString &s) {
+    if (!ok && failures.fetchAndAddRelaxed (1) < 10)
+        fprintf (stderr, "%s failed for '%s'\n", what, qPrintable (s));
+}
+
+static void stress (int thread, int iterations) {
+    int count = 0;
+    while (words[count])
+        count++;
+    QVector <TrieString> kept (count);
+    for (int i = 0; i < iterations; ++i) {
+        int w = (i * 7 + thread) % count;
+        QString word = QString::fromLatin1 (words[w]);
+        TrieString s (word);
+        check (s.toString () == word, "toString", word);
+        check (s == words[w], "compare", word);
+        check (TrieString (words[w]) == s, "intern", word);
+        check (s.startsWith (words[w]), "startsWith", word);
+
+        // a thread local word, extending a shared one
+        QString own = QString ("%1_%2_%3").arg (word).arg (thread).arg (i % 13);
+        TrieString o (own);
+        check (o.toString () == own, "toString", own);
+        check (o.startsWith (s), "startsWith", own);
+        check (o != s, "distinct", own);
+
+        if (i % 3)
+            kept[w] = s; // copies stay alive across iterations
+        else
+            kept[(w + 1) % count].clear ();
+        if (!kept[w].isNull ())
+            check (kept[w] == s, "kept", word);
+    }
+}
+
+int main (int argc, char **argv) {
+    QCoreApplication app (argc, argv);
+    int threads = argc > 1 ? atoi (argv[1]) : 8;
+    int iterations = argc > 2 ? atoi (argv[2]) : 100000;
+    Ids::init ();
+    QVector <QThread *> pool;
+    for (int t = 0; t < threads; ++t) {
+        pool.append (QThread::create ([t, iterations] () {
+            stress (t, iterations);
+        }));
+        pool.last ()->start ();
+    }
+    for (int t = 0; t < pool.size (); ++t) {
+        pool[t]->wait ();
+        delete pool[t];
+    }
+    check (Ids::attr_region == "region", "Ids", QString ("region"));
+    Ids::reset ();
+    int failed = failures.loadRelaxed ();
+    printf ("%d threads, %d iterations, %d failures\n",
+            threads, iterations, failed);
+    return failed ? 1 : 0;
+}